@@ -15,6 +15,9 @@ GOTO :paramstart
 	echo Options: ^(Use -D[option]=^<value^>^)
 	echo    ENABLE_WINGDI=[yes]^|no
 	echo    ENABLE_IUP=[yes]^|no
+	echo    ENABLE_SIMD=[yes]^|no
+	echo    WHITEPOINT_SOURCE=[scripts/gammaflux.csv]^|^<csv file^>^|planck
+	echo    WHITEPOINT_STEP=[100]^|^<K^>
 	echo    CMAKE_BUILD_TYPE=Debug^|[Release]
 GOTO:EOF
 
@@ -2,8 +2,19 @@
 /*@ignore@*/
 #include <xcb/xcb.h>
 #include <xcb/randr.h>
+#ifdef HAVE_XCB_SCREENSAVER
+# include <xcb/screensaver.h>
+#endif
+#ifdef HAVE_XCB_DPMS
+# include <xcb/dpms.h>
+/* Power level events came with DPMS 1.2 */
+# ifdef XCB_DPMS_INFO_NOTIFY
+#  define RANDR_DPMS_EVENTS
+# endif
+#endif
 /*@end@*/
 #include "gamma.h"
+#include "options.h"
 #include "randr.h"
 
 /**\brief randr storage of crtc state info */
@@ -14,6 +25,10 @@ typedef struct {
 	unsigned int ramp_size;
 	/**\brief pointer to saved gamma ramps */
 	/*@null@*/ uint16_t *saved_ramps;
+	/**\brief ramps filled for this crtc */
+	gamma_ramp_s ramp;
+	/**\brief last ramps written to this crtc */
+	gamma_commit_s commit;
 } randr_crtc_state_t;
 
 /**\brief randr storage of state info */
@@ -28,12 +43,238 @@ typedef struct {
 	unsigned int crtc_count;
 	/**\brief state of crtcs*/
 	/*@null@*/ randr_crtc_state_t *crtcs;
+	/**\brief master ramp at the largest crtc size (resample mode) */
+	gamma_ramp_s master;
+	/**\brief screensaver notify event code, 0 if not watched */
+	uint8_t saver_event;
+	/**\brief DPMS major opcode, 0 if not watched */
+	uint8_t dpms_opcode;
+	/**\brief screensaver active? */
+	int saver_on;
+	/**\brief DPMS standby, suspend or off? */
+	int dpms_off;
+	/**\brief _NET_ACTIVE_WINDOW, 0 if fullscreen windows are not followed */
+	xcb_atom_t net_active;
+	/**\brief _NET_WM_STATE */
+	xcb_atom_t net_state;
+	/**\brief _NET_WM_STATE_FULLSCREEN */
+	xcb_atom_t net_fullscreen;
+	/**\brief focused window, its property changes are watched */
+	xcb_window_t focus;
 } randr_state_t;
 
 #define RANDR_VERSION_MAJOR  1
 #define RANDR_VERSION_MINOR  3
 
-static randr_state_t state={NULL,NULL,0,0,NULL};
+static randr_state_t state={NULL,NULL,0,0,NULL,{NULL,NULL,NULL,NULL,0},
+	0,0,0,0,0,0,0,0};
+
+/* Subscribes to screensaver and DPMS events, writes stop while blanked */
+static void randr_watch_blanking(void){
+#ifdef HAVE_XCB_SCREENSAVER
+	const xcb_query_extension_reply_t *saver;
+	xcb_screensaver_query_info_reply_t *saver_info;
+#endif
+#ifdef RANDR_DPMS_EVENTS
+	const xcb_query_extension_reply_t *dpms;
+	xcb_dpms_info_reply_t *dpms_info;
+#endif
+
+	state.saver_event = 0;
+	state.dpms_opcode = 0;
+	state.saver_on = 0;
+	state.dpms_off = 0;
+#ifdef HAVE_XCB_SCREENSAVER
+	saver = xcb_get_extension_data(state.conn,&xcb_screensaver_id);
+	if( (saver!=NULL) && saver->present ){
+		state.saver_event = saver->first_event+XCB_SCREENSAVER_NOTIFY;
+		(void)xcb_screensaver_select_input(state.conn,state.screen->root,
+				XCB_SCREENSAVER_EVENT_NOTIFY_MASK);
+		saver_info = xcb_screensaver_query_info_reply(state.conn,
+				xcb_screensaver_query_info(state.conn,state.screen->root),
+				NULL);
+		if( saver_info!=NULL ){
+			state.saver_on = (saver_info->state==XCB_SCREENSAVER_STATE_ON);
+			free(saver_info);
+		}
+	}
+#endif
+#ifdef RANDR_DPMS_EVENTS
+	dpms = xcb_get_extension_data(state.conn,&xcb_dpms_id);
+	if( (dpms!=NULL) && dpms->present ){
+		state.dpms_opcode = dpms->major_opcode;
+		(void)xcb_dpms_select_input(state.conn,
+				XCB_DPMS_EVENT_MASK_INFO_NOTIFY);
+		dpms_info = xcb_dpms_info_reply(state.conn,
+				xcb_dpms_info(state.conn),NULL);
+		if( dpms_info!=NULL ){
+			state.dpms_off = dpms_info->state
+				&& (dpms_info->power_level!=XCB_DPMS_DPMS_MODE_ON);
+			free(dpms_info);
+		}
+	}
+#endif
+	(void)xcb_flush(state.conn);
+	if( !state.saver_event && !state.dpms_opcode )
+		LOG(LOGVERBOSE,_("No screensaver or DPMS events, writing while blanked"));
+	gamma_state_pause(GAMMA_PAUSE_BLANKED,state.saver_on||state.dpms_off);
+}
+
+/* Interns an atom, 0 on failure */
+static xcb_atom_t randr_atom(const char *name){
+	xcb_intern_atom_reply_t *reply;
+	xcb_atom_t atom = 0;
+
+	reply = xcb_intern_atom_reply(state.conn,xcb_intern_atom(state.conn,0,
+				(uint16_t)strlen(name),name),NULL);
+	if( reply!=NULL ){
+		atom = reply->atom;
+		free(reply);
+	}
+	return atom;
+}
+
+/* Reads a window property, NULL if missing */
+static /*@null@*/ xcb_get_property_reply_t *randr_property(xcb_window_t win,
+		xcb_atom_t prop, xcb_atom_t type){
+	xcb_get_property_reply_t *reply;
+
+	reply = xcb_get_property_reply(state.conn,xcb_get_property(state.conn,0,
+				win,prop,type,0,1024),NULL);
+	if( (reply!=NULL) && (xcb_get_property_value_length(reply)<=0) ){
+		free(reply);
+		return NULL;
+	}
+	return reply;
+}
+
+/* Checks whether the focused window is fullscreen and pauses writes */
+static void randr_fullscreen_check(void){
+	xcb_get_property_reply_t *reply;
+	const xcb_atom_t *atoms;
+	const char *instance;
+	const char *wmclass;
+	char names[256];
+	int fullscreen = 0;
+	int len;
+	int i;
+
+	if( (state.focus!=XCB_WINDOW_NONE)
+			&& ((reply=randr_property(state.focus,state.net_state,
+						XCB_ATOM_ATOM))!=NULL) ){
+		atoms = (const xcb_atom_t*)xcb_get_property_value(reply);
+		len = xcb_get_property_value_length(reply)/(int)sizeof(xcb_atom_t);
+		for( i=0; i<len; ++i )
+			if( atoms[i]==state.net_fullscreen )
+				fullscreen = 1;
+		free(reply);
+	}
+	// WM_CLASS holds the instance and class names, both NUL terminated
+	if( fullscreen && ((reply=randr_property(state.focus,XCB_ATOM_WM_CLASS,
+						XCB_ATOM_STRING))!=NULL) ){
+		len = MIN(xcb_get_property_value_length(reply),
+				(int)sizeof(names)-2);
+		memcpy(names,xcb_get_property_value(reply),(size_t)len);
+		names[len] = names[len+1] = '\0';
+		free(reply);
+		instance = names;
+		wmclass = names+strlen(names)+1;
+		if( wmclass>names+len )
+			wmclass = "";
+		fullscreen = opt_fullscreen_pauses(instance,wmclass);
+		LOG(LOGVERBOSE,_("Fullscreen window focused: %s/%s"),instance,wmclass);
+	}else if( fullscreen )
+		fullscreen = opt_fullscreen_pauses("","");
+	gamma_state_pause(GAMMA_PAUSE_FULLSCREEN,fullscreen);
+}
+
+/* Follows the focused window */
+static void randr_focus_changed(void){
+	xcb_get_property_reply_t *reply;
+	xcb_window_t focus = XCB_WINDOW_NONE;
+	uint32_t mask;
+
+	reply = randr_property(state.screen->root,state.net_active,
+			XCB_ATOM_WINDOW);
+	if( reply!=NULL ){
+		focus = *(const xcb_window_t*)xcb_get_property_value(reply);
+		free(reply);
+	}
+	if( focus!=state.focus ){
+		// Only _NET_WM_STATE changes of the focused window matter
+		mask = XCB_EVENT_MASK_NO_EVENT;
+		if( state.focus!=XCB_WINDOW_NONE )
+			(void)xcb_change_window_attributes(state.conn,state.focus,
+					XCB_CW_EVENT_MASK,&mask);
+		mask = XCB_EVENT_MASK_PROPERTY_CHANGE;
+		if( focus!=XCB_WINDOW_NONE )
+			(void)xcb_change_window_attributes(state.conn,focus,
+					XCB_CW_EVENT_MASK,&mask);
+		state.focus = focus;
+	}
+	randr_fullscreen_check();
+}
+
+/* Subscribes to focus changes of the window manager */
+static void randr_watch_fullscreen(void){
+	uint32_t mask = XCB_EVENT_MASK_PROPERTY_CHANGE;
+
+	state.net_active = 0;
+	state.focus = XCB_WINDOW_NONE;
+	if( !opt_get_fullscreen() )
+		return;
+	state.net_state = randr_atom("_NET_WM_STATE");
+	state.net_fullscreen = randr_atom("_NET_WM_STATE_FULLSCREEN");
+	state.net_active = randr_atom("_NET_ACTIVE_WINDOW");
+	if( !state.net_state || !state.net_fullscreen || !state.net_active ){
+		LOG(LOGWARN,_("Unable to follow fullscreen windows"));
+		state.net_active = 0;
+		return;
+	}
+	(void)xcb_change_window_attributes(state.conn,state.screen->root,
+			XCB_CW_EVENT_MASK,&mask);
+	randr_focus_changed();
+	(void)xcb_flush(state.conn);
+}
+
+/* Updates the pause state from an event */
+static void randr_handle_event(const xcb_generic_event_t *ev){
+	uint8_t type = ev->response_type & (uint8_t)0x7f;
+	const xcb_property_notify_event_t *prop;
+
+	if( state.net_active && (type==XCB_PROPERTY_NOTIFY) ){
+		prop = (const xcb_property_notify_event_t*)ev;
+		if( (prop->window==state.screen->root)
+				&& (prop->atom==state.net_active) )
+			randr_focus_changed();
+		else if( (prop->window==state.focus)
+				&& (prop->atom==state.net_state) )
+			randr_fullscreen_check();
+		return;
+	}
+
+#ifdef HAVE_XCB_SCREENSAVER
+	if( state.saver_event && (type==state.saver_event) ){
+		state.saver_on = (((const xcb_screensaver_notify_event_t*)ev)->state
+				==XCB_SCREENSAVER_STATE_ON);
+		gamma_state_pause(GAMMA_PAUSE_BLANKED,state.saver_on||state.dpms_off);
+		return;
+	}
+#endif
+#ifdef RANDR_DPMS_EVENTS
+	if( state.dpms_opcode && (type==XCB_GE_GENERIC)
+			&& (((const xcb_ge_generic_event_t*)ev)->extension
+				==state.dpms_opcode)
+			&& (((const xcb_ge_generic_event_t*)ev)->event_type
+				==XCB_DPMS_INFO_NOTIFY) ){
+		state.dpms_off = ((const xcb_dpms_info_notify_event_t*)ev)->power_level
+				!=XCB_DPMS_DPMS_MODE_ON;
+		gamma_state_pause(GAMMA_PAUSE_BLANKED,state.saver_on||state.dpms_off);
+		return;
+	}
+#endif
+	(void)type;
+}
 
 int randr_init(int screen_num, int crtc_num)
 {
@@ -52,6 +293,7 @@ int randr_init(int screen_num, int crtc_num)
 	uint16_t *gamma_r;
 	uint16_t *gamma_g;
 	uint16_t *gamma_b;
+	int max_size = 0;
 	
 	/* Open X server connection */
 	int preferred_screen;
@@ -76,8 +318,7 @@ int randr_init(int screen_num, int crtc_num)
 		LOG(LOGERR, _("`%s' returned error %d\n"),
 			"RANDR Query Version", error->error_code);
 		free(ver_reply);
-		xcb_disconnect(state.conn);
-		return RET_FUN_FAILED;
+		goto fail;
 	}
 
 	if (ver_reply->major_version < RANDR_VERSION_MAJOR ||
@@ -85,8 +326,7 @@ int randr_init(int screen_num, int crtc_num)
 		LOG(LOGERR, _("Unsupported RANDR version (%u.%u)\n"),
 			ver_reply->major_version, ver_reply->minor_version);
 		free(ver_reply);
-		xcb_disconnect(state.conn);
-		return RET_FUN_FAILED;
+		goto fail;
 	}
 
 	free(ver_reply);
@@ -106,8 +346,7 @@ int randr_init(int screen_num, int crtc_num)
 	if (state.screen == NULL) {
 		LOG(LOGERR, _("Screen %i could not be found.\n"),
 			screen_num);
-		xcb_disconnect(state.conn);
-		return RET_FUN_FAILED;
+		goto fail;
 	}
 
 	/* Get list of CRTCs for the screen */
@@ -122,8 +361,7 @@ int randr_init(int screen_num, int crtc_num)
 			"RANDR Get Screen Resources Current",
 			error->error_code);
 		free(res_reply);
-		xcb_disconnect(state.conn);
-		return RET_FUN_FAILED;
+		goto fail;
 	}
 
 	state.crtc_num = crtc_num;
@@ -134,8 +372,7 @@ int randr_init(int screen_num, int crtc_num)
 	if (state.crtcs == NULL) {
 		perror("malloc");
 		free(res_reply);
-		xcb_disconnect(state.conn);
-		/*@i1@*/return RET_FUN_FAILED;
+		goto fail;
 	}
 
 	crtcs = xcb_randr_get_screen_resources_current_crtcs(res_reply);
@@ -143,6 +380,11 @@ int randr_init(int screen_num, int crtc_num)
 	/* Save CRTC identifier in state */
 	for (i = 0; i < ((int)state.crtc_count); i++) {
 		state.crtcs[i].crtc = crtcs[i];
+		state.crtcs[i].ramp_size = 0;
+		state.crtcs[i].saved_ramps = NULL;
+		state.crtcs[i].ramp.all = NULL;
+		state.crtcs[i].ramp.size = 0;
+		state.crtcs[i].commit.gen = 0;
 	}
 
 	free(res_reply);
@@ -150,16 +392,6 @@ int randr_init(int screen_num, int crtc_num)
 	/* Save size and gamma ramps of all CRTCs.
 	   Current gamma ramps are saved so we can restore them
 	   at program exit. */
-		/* Allocate space for saved gamma ramps */
-	saved_ramps = malloc(state.crtc_count*3*ramp_size
-			*sizeof(uint16_t));
-	if ( !saved_ramps ) {
-		perror("malloc");
-		LOG(LOGERR,_("Memory allocation error."));
-		free(gamma_get_reply);
-		xcb_disconnect(state.conn);
-		/*@i1@*/return RET_FUN_FAILED;
-	}
 	for (i = 0; i < ((int)state.crtc_count); i++) {
 		/*@i2@*/xcb_randr_crtc_t crtc = state.crtcs[i].crtc;
 
@@ -176,8 +408,7 @@ int randr_init(int screen_num, int crtc_num)
 				"RANDR Get CRTC Gamma Size",
 				error->error_code);
 			free(gamma_size_reply);
-			xcb_disconnect(state.conn);
-			/*@i1@*/return RET_FUN_FAILED;
+			goto fail;
 		}
 
 		ramp_size = (unsigned int)gamma_size_reply->size;
@@ -188,8 +419,18 @@ int randr_init(int screen_num, int crtc_num)
 		if (ramp_size == 0) {
 			LOG(LOGERR, _("Gamma ramp size too small: %i\n"),
 				ramp_size);
-			xcb_disconnect(state.conn);
-			/*@i1@*/return RET_FUN_FAILED;
+			goto fail;
+		}
+
+		/* Allocate space for saved gamma ramps */
+		state.crtcs[i].saved_ramps = malloc(3*ramp_size*sizeof(uint16_t));
+		/* Each CRTC keeps its own ramp buffer for the set path */
+		state.crtcs[i].ramp = gamma_pool_get((int)ramp_size);
+		if ( (state.crtcs[i].saved_ramps==NULL)
+				|| (state.crtcs[i].ramp.all==NULL) ) {
+			perror("malloc");
+			LOG(LOGERR,_("Memory allocation error."));
+			goto fail;
 		}
 
 		/* Request current gamma ramps */
@@ -202,8 +443,7 @@ int randr_init(int screen_num, int crtc_num)
 			LOG(LOGERR, _("`%s' returned error %d\n"),
 				"RANDR Get CRTC Gamma", error->error_code);
 			free(gamma_get_reply);
-			xcb_disconnect(state.conn);
-			/*@i1@*/return RET_FUN_FAILED;
+			goto fail;
 		}
 
 		gamma_r = xcb_randr_get_crtc_gamma_red(gamma_get_reply);
@@ -219,9 +459,39 @@ int randr_init(int screen_num, int crtc_num)
 		       ramp_size*sizeof(uint16_t));
 
 		free(gamma_get_reply);
+
+		if( (int)ramp_size > max_size )
+			max_size = (int)ramp_size;
+	}
+
+	randr_watch_blanking();
+	randr_watch_fullscreen();
+
+	/* One master ramp is computed per step and resampled to each CRTC */
+	gamma_pool_put(&state.master);
+	if( opt_get_resample() && (state.crtc_count>1) ){
+		LOG(LOGVERBOSE,_("Using %d entry master ramp"),max_size);
+		state.master = gamma_pool_get(max_size);
 	}
 
 	/*@i1@*/return RET_FUN_SUCCESS;
+
+fail:
+	/* Ramps and buffers taken so far, unset ones are NULL */
+	if( state.crtcs!=NULL ){
+		for( i=0; i<(int)state.crtc_count; ++i ){
+			if( state.crtcs[i].saved_ramps!=NULL )
+				free(state.crtcs[i].saved_ramps);
+			gamma_pool_put(&state.crtcs[i].ramp);
+		}
+		free(state.crtcs);
+		state.crtcs = NULL;
+	}
+	state.crtc_count = 0;
+	state.screen = NULL;
+	xcb_disconnect(state.conn);
+	state.conn = NULL;
+	/*@i1@*/return RET_FUN_FAILED;
 }
 
 void randr_restore(void){
@@ -262,6 +532,7 @@ void randr_restore(void){
 				"RANDR Set CRTC Gamma", error->error_code);
 			LOG(LOGERR, _("Unable to restore CRTC %i\n"), i);
 		}
+		state.crtcs[i].commit.gen = 0;
 	}
 }
 
@@ -278,23 +549,28 @@ int randr_free(void){
 			LOG(LOGVERBOSE,_("Freeing Randr CRTC %d"),i);
 			free(state.crtcs[i].saved_ramps);
 		}
+		gamma_pool_put(&state.crtcs[i].ramp);
 	}
+	gamma_pool_put(&state.master);
 	free(state.crtcs);
 	state.crtcs=NULL;
 
 	/* Close connection */
 	if( state.conn!=NULL )
 		xcb_disconnect(state.conn);
+	state.conn = NULL;
+	state.screen = NULL;
 
 	LOG(LOGVERBOSE,_("Randr memory freed successfully."));
 	return RET_FUN_SUCCESS;
 }
 
 static int randr_set_temperature_for_crtc(int crtc_num, int temp,
-			       /*@unused@*/ gamma_s gamma)
+			       /*@unused@*/ gamma_s gamma,
+			       /*@null@*/ const gamma_ramp_s *master)
 {
 	xcb_generic_error_t *error;
-	gamma_ramp_s ramp;
+	gamma_ramp_s *ramp;
 	unsigned int ramp_size;
 	xcb_randr_crtc_t crtc;
 	xcb_void_cookie_t gamma_set_cookie;
@@ -317,21 +593,21 @@ static int randr_set_temperature_for_crtc(int crtc_num, int temp,
 	crtc = state.crtcs[crtc_num].crtc;
 	ramp_size = state.crtcs[crtc_num].ramp_size;
 
-	ramp = gamma_ramp_fill((int)ramp_size,temp);
-	if( (!ramp.size)
-			||(ramp.r==NULL)
-			||(ramp.g==NULL)
-			||(ramp.b==NULL) )
+	ramp = &state.crtcs[crtc_num].ramp;
+	if( ((master==NULL) || !gamma_ramp_resample(master,ramp))
+			&& !gamma_ramp_fill(ramp,temp) )
 		return RET_FUN_FAILED;
 	if( state.conn==NULL ){
 		LOG(LOGERR,_("No connection available"));
 		return RET_FUN_FAILED;
 	}
+	if( !gamma_commit_needed(&state.crtcs[crtc_num].commit,ramp) )
+		return RET_FUN_SUCCESS;
 
 	/* Set new gamma ramps */
 	gamma_set_cookie = xcb_randr_set_crtc_gamma_checked(state.conn, crtc,
-						 (uint16_t)ramp_size, ramp.r,
-						 ramp.g, ramp.b);
+						 (uint16_t)ramp_size, ramp->r,
+						 ramp->g, ramp->b);
 	error = xcb_request_check(state.conn, gamma_set_cookie);
 
 	if (error) {
@@ -339,8 +615,9 @@ static int randr_set_temperature_for_crtc(int crtc_num, int temp,
 			"RANDR Set CRTC Gamma", error->error_code);
 		return RET_FUN_FAILED;
 	}
+	gamma_commit_done(&state.crtcs[crtc_num].commit);
 	LOG(LOGVERBOSE,_("Set gamma[CRTC %d], end points: (%d,%d)"),
-			crtc_num,ramp.r[ramp_size-1],ramp.b[ramp_size-1]);
+			crtc_num,ramp->r[ramp_size-1],ramp->b[ramp_size-1]);
 
 	return RET_FUN_SUCCESS;
 }
@@ -350,14 +627,18 @@ int randr_set_temperature(int temp, gamma_s gamma){
 	   set temperature on all CRTCs. */
 	if (state.crtc_num < 0) {
 		int i;
+		gamma_ramp_s *master = NULL;
+		if( (state.master.all!=NULL)
+				&& gamma_ramp_fill(&state.master,temp) )
+			master = &state.master;
 		for (i = 0; i < ((int)state.crtc_count); i++) {
 			if(!randr_set_temperature_for_crtc(i,
-							   temp, gamma))
+							   temp, gamma, master))
 				return RET_FUN_FAILED;
 		}
 	} else {
 		return randr_set_temperature_for_crtc(state.crtc_num,
-						      temp, gamma);
+						      temp, gamma, NULL);
 	}
 
 	return RET_FUN_SUCCESS;
@@ -391,23 +672,39 @@ int randr_get_temperature(void){
 		free(gamma_get_reply);
 		/*@i2@*/return RET_FUN_FAILED;
 	}else{
-		uint16_t *gamma_r,*gamma_b;
-		int gamma_r_length,gamma_b_length;
-		uint16_t gamma_r_end,gamma_b_end;
-		float rb_ratio;
+		uint16_t *gamma_r,*gamma_g,*gamma_b;
+		int temp;
 	
 		gamma_r = xcb_randr_get_crtc_gamma_red(gamma_get_reply);
+		gamma_g = xcb_randr_get_crtc_gamma_green(gamma_get_reply);
 		gamma_b = xcb_randr_get_crtc_gamma_blue(gamma_get_reply);
-		gamma_r_length = xcb_randr_get_crtc_gamma_red_length(gamma_get_reply);
-		gamma_b_length = xcb_randr_get_crtc_gamma_blue_length(gamma_get_reply);
-		gamma_r_end = gamma_r[gamma_r_length-1];
-		gamma_b_end = gamma_b[gamma_b_length-1];
-		LOG(LOGVERBOSE,_("Gamma end points: (%d,%d)"),
-				gamma_r_end,gamma_b_end);
-		rb_ratio = ((float)gamma_r_end)/((float)gamma_b_end);
+		temp = gamma_ramp_read_temp(gamma_r,gamma_g,gamma_b,
+				xcb_randr_get_crtc_gamma_red_length(gamma_get_reply));
 		free(gamma_get_reply);
-		/*@i2@*/return gamma_find_temp(rb_ratio);
+		/*@i2@*/return temp;
+	}
+}
+
+int randr_get_fd(void){
+	if( state.conn==NULL )
+		return -1;
+	return xcb_get_file_descriptor(state.conn);
+}
+
+int randr_handle_events(void){
+	xcb_generic_event_t *ev;
+
+	if( state.conn==NULL )
+		return RET_FUN_FAILED;
+	while( (ev=xcb_poll_for_event(state.conn))!=NULL ){
+		randr_handle_event(ev);
+		free(ev);
+	}
+	if( xcb_connection_has_error(state.conn) ){
+		LOG(LOGERR,_("Lost connection to the X server"));
+		return RET_FUN_FAILED;
 	}
+	return RET_FUN_SUCCESS;
 }
 
 int randr_load_funcs(gamma_method_s *method){
@@ -415,6 +712,8 @@ int randr_load_funcs(gamma_method_s *method){
 	method->func_end = &randr_free;
 	method->func_set_temp = &randr_set_temperature;
 	method->func_get_temp = &randr_get_temperature;
+	method->func_get_fd = &randr_get_fd;
+	method->func_handle_events = &randr_handle_events;
 	method->name = "RANDR";
 	return RET_FUN_SUCCESS;
 }
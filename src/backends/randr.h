@@ -25,6 +25,17 @@ int randr_set_temperature(int temp, gamma_s gamma);
  */
 int randr_get_temperature(void);
 
+/**\brief Retrieves the file descriptor of the X connection */
+int randr_get_fd(void);
+
+/**\brief Handles pending X events
+ * \details Screensaver and DPMS (1.2) power level events pause ramp writes,
+ * and so does a focused fullscreen window with opt_set_fullscreen(), see
+ * gamma_state_pause().
+ * \return RET_FUN_FAILED if the connection was lost
+ */
+int randr_handle_events(void);
+
 /**\brief loads functions into methods structure */
 int randr_load_funcs(gamma_method_s *method);
 
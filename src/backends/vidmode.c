@@ -16,9 +16,13 @@ typedef struct {
 	int ramp_size;
 	/**\brief Saved ramps */
 	uint16_t *saved_ramps;
+	/**\brief Ramps filled for the screen */
+	gamma_ramp_s ramp;
+	/**\brief Last ramps written to the screen */
+	gamma_commit_s commit;
 } vidmode_state_t;
 
-static vidmode_state_t state={NULL,0,0,NULL};
+static vidmode_state_t state={NULL,0,0,NULL,{NULL,NULL,NULL,NULL,0},{0,0,0}};
 
 int vidmode_init(int screen_num,int crtc_num)
 {
@@ -64,10 +68,10 @@ int vidmode_init(int screen_num,int crtc_num)
 
 	/* Allocate space for saved gamma ramps */
 	state.saved_ramps = malloc(3*state.ramp_size*sizeof(uint16_t));
-	if (state.saved_ramps == NULL) {
+	state.ramp = gamma_pool_get(state.ramp_size);
+	if ( (state.saved_ramps == NULL) || (state.ramp.all == NULL) ) {
 		perror("malloc");
-		XCloseDisplay(state.display);
-		return RET_FUN_FAILED;
+		goto fail;
 	}
 
 	gamma_r = &state.saved_ramps[0*state.ramp_size];
@@ -80,17 +84,26 @@ int vidmode_init(int screen_num,int crtc_num)
 				    gamma_b) ){
 		LOG(LOGERR, _("X request failed: %s\n"),
 			"XF86VidModeGetGammaRamp");
-		XCloseDisplay(state.display);
-		return RET_FUN_FAILED;
+		goto fail;
 	}
 
 	return RET_FUN_SUCCESS;
+
+fail:
+	/* Either buffer may be unset, free() and the pool take NULL */
+	free(state.saved_ramps);
+	state.saved_ramps = NULL;
+	gamma_pool_put(&state.ramp);
+	XCloseDisplay(state.display);
+	state.display = NULL;
+	return RET_FUN_FAILED;
 }
 
 int vidmode_free(void)
 {
 	/* Free saved ramps */
 	free(state.saved_ramps);
+	gamma_pool_put(&state.ramp);
 
 	/* Close display connection */
 	XCloseDisplay(state.display);
@@ -110,25 +123,26 @@ void vidmode_restore(void)
 		LOG(LOGERR, _("X request failed: %s\n"),
 			"XF86VidModeSetGammaRamp");
 	}
+	state.commit.gen = 0;
 }
 
 int vidmode_set_temperature(int temp, gamma_s gamma)
 {
 	/* Create new gamma ramps */
-	gamma_ramp_s ramp;
-
-	ramp = gamma_ramp_fill(state.ramp_size,temp);
-	if( !ramp.size )
+	if( !gamma_ramp_fill(&state.ramp,temp) )
 		return RET_FUN_FAILED;
+	if( !gamma_commit_needed(&state.commit,&state.ramp) )
+		return RET_FUN_SUCCESS;
 
 	/* Set new gamma ramps */
 	if( !XF86VidModeSetGammaRamp(state.display, state.screen_num,
-				    ramp.size, ramp.r, ramp.g,
-				    ramp.b)){
+				    state.ramp.size, state.ramp.r, state.ramp.g,
+				    state.ramp.b)){
 		LOG(LOGERR, _("X request failed: %s\n"),
 			"XF86VidModeSetGammaRamp");
 		return RET_FUN_FAILED;
 	}
+	gamma_commit_done(&state.commit);
 	return RET_FUN_SUCCESS;
 }
 
@@ -150,24 +164,38 @@ int vidmode_get_temperature(void){
 		free(gamma_b);
 		return RET_FUN_FAILED;
 	}else{
-		uint16_t gamma_r_end = gamma_r[state.ramp_size-1];
-		uint16_t gamma_b_end = gamma_b[state.ramp_size-1];
-		float rb_ratio = (float)gamma_r_end/(float)gamma_b_end;
-
-		LOG(LOGVERBOSE,_("Red end: %uK, Blue end: %uK"),
-				gamma_r_end,gamma_b_end);
+		int temp = gamma_ramp_read_temp(gamma_r,gamma_g,gamma_b,
+				state.ramp_size);
 		free(gamma_r);
 		free(gamma_g);
 		free(gamma_b);
-		return gamma_find_temp(rb_ratio);
+		return temp;
 	}
 }
 
+int vidmode_get_fd(void){
+	if( state.display==NULL )
+		return -1;
+	return ConnectionNumber(state.display);
+}
+
+int vidmode_handle_events(void){
+	XEvent ev;
+
+	if( state.display==NULL )
+		return RET_FUN_FAILED;
+	while( XPending(state.display)>0 )
+		(void)XNextEvent(state.display,&ev);
+	return RET_FUN_SUCCESS;
+}
+
 int vidmode_load_funcs(gamma_method_s *method){
 	method->func_init = &vidmode_init;
 	method->func_end = &vidmode_free;
 	method->func_set_temp = &vidmode_set_temperature;
 	method->func_get_temp = &vidmode_get_temperature;
+	method->func_get_fd = &vidmode_get_fd;
+	method->func_handle_events = &vidmode_handle_events;
 	method->name = "VidMode";
 	return RET_FUN_SUCCESS;
 }
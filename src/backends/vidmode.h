@@ -23,6 +23,12 @@ int vidmode_set_temperature(int temp, gamma_s gamma);
 /**\brief Retrieves temperature using VidMode */
 int vidmode_get_temperature(void);
 
+/**\brief Retrieves the file descriptor of the X connection */
+int vidmode_get_fd(void);
+
+/**\brief Discards pending X events */
+int vidmode_handle_events(void);
+
 /**\brief Loads VidMode functions into methods structure */
 int vidmode_load_funcs(gamma_method_s *method);
 
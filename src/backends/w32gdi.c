@@ -31,11 +31,15 @@ typedef /*@partial@*/ struct {
 	/*@null@*//*@partial@*/ HDC hDC;
 	/**\brief Saved ramps */
 	/*@null@*//*@partial@*/ WORD *saved_ramps;
+	/**\brief Ramps filled for the display */
+	gamma_ramp_s ramp;
+	/**\brief Last ramps written to the display */
+	gamma_commit_s commit;
 } w32gdi_state_t;
 
 #define GAMMA_RAMP_SIZE  256
 
-static w32gdi_state_t state={NULL,NULL};
+static w32gdi_state_t state={NULL,NULL,{NULL,NULL,NULL,NULL,0},{0,0,0}};
 
 static int w32gdi_init(/*@unused@*/int screen_num,/*@unused@*/ int crtc_num)
 {
@@ -61,7 +65,9 @@ static int w32gdi_init(/*@unused@*/int screen_num,/*@unused@*/ int crtc_num)
 	if(state.saved_ramps)
 		free(state.saved_ramps);
 	state.saved_ramps = malloc(3*GAMMA_RAMP_SIZE*sizeof(WORD));
-	if (state.saved_ramps == NULL) {
+	gamma_pool_put(&state.ramp);
+	state.ramp = gamma_pool_get(GAMMA_RAMP_SIZE);
+	if ( (state.saved_ramps == NULL) || (state.ramp.all == NULL) ) {
 		perror("malloc");
 		(void)ReleaseDC(NULL, state.hDC);
 		return RET_FUN_FAILED;
@@ -81,6 +87,7 @@ static int w32gdi_free(void)
 {
 	/* Free saved ramps */
 	free(state.saved_ramps);
+	gamma_pool_put(&state.ramp);
 
 	/* Release device context */
 	if( state.hDC )
@@ -95,6 +102,7 @@ static int w32gdi_restore(void)
 		LOG(LOGERR,_("No device context or ramp."));
 		return RET_FUN_FAILED;
 	}
+	state.commit.gen = 0;
 	if( !SetDeviceGammaRamp(state.hDC, state.saved_ramps) ){
 		LOG(LOGERR,_("Unable to restore gamma ramps."));
 		return RET_FUN_FAILED;
@@ -104,40 +112,36 @@ static int w32gdi_restore(void)
 
 static int w32gdi_set_temperature(int temp, /*@unused@*/ gamma_s gamma)
 {
-	gamma_ramp_s ramp=gamma_ramp_fill(GAMMA_RAMP_SIZE,temp);
-
 	/* Set new gamma ramps */
-	if( (!state.hDC)||(!ramp.all) ){
+	if( (!state.hDC)||(!gamma_ramp_fill(&state.ramp,temp)) ){
 		LOG(LOGERR,_("No device context or ramp."));
 		return RET_FUN_FAILED;
 	}
-	if( !SetDeviceGammaRamp(state.hDC,ramp.all)) {
+	if( !gamma_commit_needed(&state.commit,&state.ramp) )
+		return RET_FUN_SUCCESS;
+	if( !SetDeviceGammaRamp(state.hDC,state.ramp.all)) {
 		LOG(LOGERR,_("Unable to set gamma ramps."));
 		return RET_FUN_FAILED;
 	}
+	gamma_commit_done(&state.commit);
 
 	return RET_FUN_SUCCESS;
 }
 
 static int w32gdi_get_temperature(void){
-	gamma_ramp_s ramp=gamma_get_ramps(GAMMA_RAMP_SIZE);
-	float rb_ratio;
+	WORD ramps[3*GAMMA_RAMP_SIZE];
 	
-	if( (!state.hDC)||(!ramp.all) ){
+	if( !state.hDC ){
 		LOG(LOGERR,_("No device context or ramp."));
 		return RET_FUN_FAILED;
 	}
 
-	if( !GetDeviceGammaRamp(state.hDC,ramp.all) ){
+	if( !GetDeviceGammaRamp(state.hDC,ramps) ){
 		LOG(LOGERR,_("Unable to get gamma ramps."));
 		return RET_FUN_FAILED;
 	}
-	if( (!ramp.r)||(!ramp.b) ){
-		LOG(LOGERR,_("No ramps found."));
-		return RET_FUN_FAILED;
-	}
-	rb_ratio = (float)ramp.r[255]/(float)ramp.b[255];
-	return gamma_find_temp(rb_ratio);
+	return gamma_ramp_read_temp(ramps,ramps+GAMMA_RAMP_SIZE,
+			ramps+2*GAMMA_RAMP_SIZE,GAMMA_RAMP_SIZE);
 }
 
 int w32gdi_load_funcs(gamma_method_s *method){
@@ -0,0 +1,99 @@
+#include "common.h"
+#ifdef HAVE_EVLOOP
+#include <errno.h>
+#include <sys/inotify.h>
+#include "evloop.h"
+#include "cfgwatch.h"
+
+/**\brief Watch state */
+typedef struct{
+	/**\brief inotify instance, -1 if not watching */
+	int fd;
+	/**\brief Change handler */
+	/*@null@*/ cfgwatch_func func;
+	/**\brief Handler data */
+	/*@null@*//*@dependent@*/ void *data;
+	/**\brief File name within the watched directory */
+	char name[LONGEST_PATH];
+} cfgwatch_s;
+
+static cfgwatch_s cfgwatch = {-1};
+
+// Reads all pending events, the handler runs once for all of them
+static void cfgwatch_ready(int fd, int events, /*@unused@*/ void *data){
+	union{
+		struct inotify_event event;
+		char buf[CFGWATCH_BUFSIZE];
+	} u;
+	const struct inotify_event *ev;
+	ssize_t n;
+	size_t pos;
+	int changed = 0;
+	int gone = (events & EVLOOP_ERR);
+
+	while( (n=read(fd,u.buf,sizeof(u.buf)))>0 ){
+		for( pos=0; pos<(size_t)n;
+				pos+=sizeof(struct inotify_event)+ev->len ){
+			ev = (const struct inotify_event*)(u.buf+pos);
+			if( ev->mask & IN_IGNORED )
+				gone = 1;
+			else if( (ev->len>0) && (strcmp(ev->name,cfgwatch.name)==0) )
+				changed = 1;
+		}
+	}
+	if( changed && cfgwatch.func )
+		cfgwatch.func(cfgwatch.data);
+	// Directory removed or unmounted
+	if( gone ){
+		LOG(LOGWARN,_("Configuration directory gone, no more reloads"));
+		cfgwatch_end();
+	}
+}
+
+/* Starts watching */
+int cfgwatch_init(const char *path, cfgwatch_func func, void *data){
+	char dir[LONGEST_PATH];
+	const char *sep = strrchr(path,PATH_SEP);
+	int fd;
+
+	if( !sep || (strlen(path)>=sizeof(dir)) ){
+		LOG(LOGERR,_("Invalid configuration path: %s"),path);
+		return RET_FUN_FAILED;
+	}
+	memcpy(dir,path,(size_t)(sep-path));
+	dir[sep-path] = '\0';
+	if( dir[0]=='\0' )
+		strcpy(dir,"/");
+	strcpy(cfgwatch.name,sep+1);
+	fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+	if( fd<0 ){
+		LOG(LOGERR,_("Unable to create inotify instance: %s"),strerror(errno));
+		return RET_FUN_FAILED;
+	}
+	// Written in place or renamed over
+	if( inotify_add_watch(fd,dir,IN_CLOSE_WRITE|IN_MOVED_TO)<0 ){
+		LOG(LOGERR,_("Unable to watch %s: %s"),dir,strerror(errno));
+		(void)close(fd);
+		return RET_FUN_FAILED;
+	}
+	if( !evloop_add(fd,&cfgwatch_ready,NULL) ){
+		(void)close(fd);
+		return RET_FUN_FAILED;
+	}
+	cfgwatch.fd = fd;
+	cfgwatch.func = func;
+	cfgwatch.data = data;
+	LOG(LOGVERBOSE,_("Watching %s for changes"),path);
+	return RET_FUN_SUCCESS;
+}
+
+/* Stops watching */
+void cfgwatch_end(void){
+	if( cfgwatch.fd<0 )
+		return;
+	(void)evloop_remove(cfgwatch.fd);
+	(void)close(cfgwatch.fd);
+	cfgwatch.fd = -1;
+}
+
+#endif /* HAVE_EVLOOP */
@@ -0,0 +1,32 @@
+/**\file		cfgwatch.h
+ * \brief		Configuration file watch of the console daemon.
+ * \details
+ * Watches the configuration file with inotify from the event loop and
+ * calls a handler once per wakeup in which the file was written.  The
+ * directory is watched rather than the file, so editors that save by
+ * writing a new file and renaming it over the old one are noticed too.
+ * Only built with HAVE_EVLOOP.
+ */
+
+#ifndef __CFGWATCH_H__
+#define __CFGWATCH_H__
+#ifdef HAVE_EVLOOP
+
+/**\brief Size of the buffer inotify events are read into */
+#define CFGWATCH_BUFSIZE	4096
+
+/**\brief Handles a change of the file */
+typedef void (*cfgwatch_func)(/*@null@*/ void *data);
+
+/**\brief Starts watching a file
+ * \param path path of the file, it does not need to exist yet
+ * \param func called after the file was written or replaced
+ * \param data passed to func
+ */
+int cfgwatch_init(const char *path, cfgwatch_func func, /*@null@*/ void *data);
+
+/**\brief Stops watching */
+void cfgwatch_end(void);
+
+#endif /* HAVE_EVLOOP */
+#endif//__CFGWATCH_H__
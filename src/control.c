@@ -0,0 +1,246 @@
+#include "common.h"
+#ifdef HAVE_EVLOOP
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "evloop.h"
+#include "control.h"
+
+/**\brief Connected client */
+typedef struct{
+	/**\brief Socket, -1 if the slot is free */
+	int fd;
+	/**\brief Bytes of an incomplete line */
+	size_t len;
+	/**\brief Incomplete line */
+	char buf[CONTROL_LINE_MAX];
+} control_client_s;
+
+/**\brief Control socket state */
+typedef struct{
+	/**\brief Listening socket */
+	int fd;
+	/**\brief Command handler */
+	/*@null@*/ control_func func;
+	/**\brief Handler data */
+	/*@null@*//*@dependent@*/ void *data;
+	/**\brief Socket path, removed on exit */
+	char path[sizeof(((struct sockaddr_un*)NULL)->sun_path)];
+	/**\brief Clients */
+	control_client_s clients[CONTROL_MAX_CLIENTS];
+} control_s;
+
+static control_s control = {-1};
+
+/* Retrieves the socket path */
+int control_get_path(char buffer[], size_t bufsize){
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+	int len;
+
+	if( (dir!=NULL) && (dir[0]!='\0') )
+		len = snprintf(buffer,bufsize,"%s/redshiftgui.sock",dir);
+	else
+		len = snprintf(buffer,bufsize,"/tmp/redshiftgui-%u.sock",
+				(unsigned int)getuid());
+	if( (len<0) || ((size_t)len>=bufsize)
+			|| ((size_t)len>=sizeof(control.path)) ){
+		LOG(LOGERR,_("Control socket path too long"));
+		return RET_FUN_FAILED;
+	}
+	return RET_FUN_SUCCESS;
+}
+
+// Fills a socket address
+static int control_address(/*@out@*/ struct sockaddr_un *addr){
+	memset(addr,0,sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	return control_get_path(addr->sun_path,sizeof(addr->sun_path));
+}
+
+// Disconnects a client
+static void control_drop(control_client_s *client){
+	(void)evloop_remove(client->fd);
+	(void)close(client->fd);
+	client->fd = -1;
+	client->len = 0;
+}
+
+// Answers every complete line of a client
+static void control_lines(control_client_s *client){
+	char reply[CONTROL_LINE_MAX+1];
+	char *end;
+	size_t used;
+
+	while( (end=memchr(client->buf,'\n',client->len))!=NULL ){
+		*end = '\0';
+		if( (end>client->buf) && (end[-1]=='\r') )
+			end[-1] = '\0';
+		reply[0] = '\0';
+		if( control.func )
+			control.func(client->buf,reply,CONTROL_LINE_MAX,control.data);
+		used = strlen(reply);
+		reply[used++] = '\n';
+		// Answers are short, a fresh socket buffer always takes them
+		(void)send(client->fd,reply,used,MSG_NOSIGNAL);
+		used = (size_t)(end-client->buf)+1;
+		client->len -= used;
+		memmove(client->buf,client->buf+used,client->len);
+	}
+}
+
+// Reads from a client
+static void control_client_ready(int fd, int events, void *data){
+	control_client_s *client = (control_client_s*)data;
+	ssize_t n;
+
+	(void)fd;
+	n = read(client->fd,client->buf+client->len,
+			sizeof(client->buf)-client->len);
+	if( n>0 ){
+		client->len += (size_t)n;
+		control_lines(client);
+		if( client->len<sizeof(client->buf) )
+			return;
+		(void)send(client->fd,"err line too long\n",18,MSG_NOSIGNAL);
+	}else if( (n<0) && (errno==EAGAIN) && !(events & EVLOOP_ERR) )
+		return;
+	control_drop(client);
+}
+
+// Accepts clients
+static void control_accept(int fd, int events, void *data){
+	control_client_s *client;
+	int cfd;
+	int i;
+
+	(void)events;
+	(void)data;
+	while( (cfd=accept(fd,NULL,NULL))>=0 ){
+		(void)fcntl(cfd,F_SETFD,FD_CLOEXEC);
+		(void)fcntl(cfd,F_SETFL,O_NONBLOCK);
+		for( i=0; (i<CONTROL_MAX_CLIENTS)
+				&& (control.clients[i].fd>=0); ++i );
+		if( i==CONTROL_MAX_CLIENTS ){
+			(void)send(cfd,"err busy\n",9,MSG_NOSIGNAL);
+			(void)close(cfd);
+			continue;
+		}
+		client = &control.clients[i];
+		client->fd = cfd;
+		client->len = 0;
+		if( !evloop_add(cfd,&control_client_ready,client) ){
+			(void)close(cfd);
+			client->fd = -1;
+		}
+	}
+}
+
+/* Listens on the socket */
+int control_init(control_func func, void *data){
+	struct sockaddr_un addr;
+	int fd;
+	int i;
+
+	if( !control_address(&addr) )
+		return RET_FUN_FAILED;
+	for( i=0; i<CONTROL_MAX_CLIENTS; ++i ){
+		control.clients[i].fd = -1;
+		control.clients[i].len = 0;
+	}
+	fd = socket(AF_UNIX,SOCK_STREAM|SOCK_CLOEXEC,0);
+	if( fd<0 ){
+		LOG(LOGERR,_("Unable to create control socket: %s"),strerror(errno));
+		return RET_FUN_FAILED;
+	}
+	// Someone answering means another daemon, otherwise the file is stale
+	if( connect(fd,(struct sockaddr*)&addr,sizeof(addr))==0 ){
+		LOG(LOGERR,_("Another instance is listening on %s"),addr.sun_path);
+		(void)close(fd);
+		return RET_FUN_FAILED;
+	}
+	(void)unlink(addr.sun_path);
+	if( (bind(fd,(struct sockaddr*)&addr,sizeof(addr))!=0)
+			|| (chmod(addr.sun_path,S_IRUSR|S_IWUSR)!=0)
+			|| (listen(fd,CONTROL_MAX_CLIENTS)!=0) ){
+		LOG(LOGERR,_("Unable to listen on %s: %s"),addr.sun_path,
+				strerror(errno));
+		(void)close(fd);
+		return RET_FUN_FAILED;
+	}
+	(void)fcntl(fd,F_SETFL,O_NONBLOCK);
+	if( !evloop_add(fd,&control_accept,NULL) ){
+		(void)close(fd);
+		(void)unlink(addr.sun_path);
+		return RET_FUN_FAILED;
+	}
+	control.fd = fd;
+	control.func = func;
+	control.data = data;
+	strcpy(control.path,addr.sun_path);
+	LOG(LOGVERBOSE,_("Listening on %s"),control.path);
+	return RET_FUN_SUCCESS;
+}
+
+/* Closes the socket */
+void control_end(void){
+	int i;
+
+	if( control.fd<0 )
+		return;
+	for( i=0; i<CONTROL_MAX_CLIENTS; ++i )
+		if( control.clients[i].fd>=0 )
+			control_drop(&control.clients[i]);
+	(void)evloop_remove(control.fd);
+	(void)close(control.fd);
+	(void)unlink(control.path);
+	control.fd = -1;
+}
+
+/* Sends a command and prints the answer */
+int control_send(const char *cmd){
+	struct sockaddr_un addr;
+	char line[CONTROL_LINE_MAX+1];
+	size_t len = strlen(cmd);
+	size_t got = 0;
+	ssize_t n;
+	int fd;
+
+	if( len>=CONTROL_LINE_MAX ){
+		LOG(LOGERR,_("Command too long"));
+		return RET_FUN_FAILED;
+	}
+	if( !control_address(&addr) )
+		return RET_FUN_FAILED;
+	fd = socket(AF_UNIX,SOCK_STREAM|SOCK_CLOEXEC,0);
+	if( (fd<0) || (connect(fd,(struct sockaddr*)&addr,sizeof(addr))!=0) ){
+		LOG(LOGERR,_("No daemon listening on %s: %s"),addr.sun_path,
+				strerror(errno));
+		if( fd>=0 )
+			(void)close(fd);
+		return RET_FUN_FAILED;
+	}
+	memcpy(line,cmd,len);
+	line[len] = '\n';
+	if( send(fd,line,len+1,MSG_NOSIGNAL)!=(ssize_t)(len+1) ){
+		(void)close(fd);
+		return RET_FUN_FAILED;
+	}
+	(void)shutdown(fd,SHUT_WR);
+	// One line back
+	while( (got<CONTROL_LINE_MAX)
+			&& ((n=read(fd,line+got,CONTROL_LINE_MAX-got))>0) ){
+		got += (size_t)n;
+		if( memchr(line,'\n',got)!=NULL )
+			break;
+	}
+	(void)close(fd);
+	line[got] = '\0';
+	printf("%s",line);
+	if( (got==0) || (line[got-1]!='\n') )
+		printf("\n");
+	return (strncmp(line,"ok",2)==0) ? RET_FUN_SUCCESS : RET_FUN_FAILED;
+}
+
+#endif /* HAVE_EVLOOP */
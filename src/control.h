@@ -0,0 +1,53 @@
+/**\file		control.h
+ * \brief		Control socket of the console daemon.
+ * \details
+ * The daemon listens on a Unix stream socket in $XDG_RUNTIME_DIR (or /tmp)
+ * for one line commands and answers each with one line starting with
+ * "ok" or "err".  Connections are served from the event loop and their
+ * buffers live in a fixed table.  What the commands do is up to the
+ * handler given to control_init(), see the console in redshiftgui.c:
+ *
+ *   temp <K>, bright <B>, pause, resume, status, reload
+ *
+ * control_send() is the client side, it sends one command and prints the
+ * answer without initializing anything else.  Only built with HAVE_EVLOOP.
+ */
+
+#ifndef __CONTROL_H__
+#define __CONTROL_H__
+#ifdef HAVE_EVLOOP
+
+/**\brief Longest command or answer line */
+#define CONTROL_LINE_MAX	256
+/**\brief Maximum number of clients connected at once */
+#define CONTROL_MAX_CLIENTS	4
+
+/**\brief Handles one command
+ * \param cmd command line without the line feed
+ * \param reply buffer for the answer, without the line feed
+ * \param size size of reply
+ * \param data pointer given to control_init()
+ */
+typedef void (*control_func)(const char *cmd, char *reply, size_t size,
+		/*@null@*/ void *data);
+
+/**\brief Retrieves the socket path
+ * \return RET_FUN_FAILED if it does not fit in buffer
+ */
+int control_get_path(/*@out@*/ char buffer[], size_t bufsize);
+
+/**\brief Listens on the socket, from the event loop
+ * \details Fails if another daemon already answers on it.
+ */
+int control_init(control_func func, /*@null@*/ void *data);
+
+/**\brief Closes the socket and all connections */
+void control_end(void);
+
+/**\brief Sends a command to the running daemon and prints the answer
+ * \return RET_FUN_FAILED if no daemon answered or the answer is an error
+ */
+int control_send(const char *cmd);
+
+#endif /* HAVE_EVLOOP */
+#endif//__CONTROL_H__
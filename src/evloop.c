@@ -0,0 +1,371 @@
+#include "common.h"
+#ifdef HAVE_EVLOOP
+#include <errno.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include "systemtime.h"
+#include "evloop.h"
+
+/* Tags of the built-in sources, after the evloop_add() slots */
+#define TAG_TIMER	EVLOOP_MAX_SOURCES
+#define TAG_SIGNAL	(EVLOOP_MAX_SOURCES+1)
+#define TAG_CLOCK	(EVLOOP_MAX_SOURCES+2)
+
+/* How far ahead the clock timer is armed, it is rearmed if it expires */
+#define CLOCK_SPAN	(86400*365)
+
+#ifndef TFD_TIMER_CANCEL_ON_SET
+# define TFD_TIMER_CANCEL_ON_SET (1<<1)
+#endif
+
+/**\brief File descriptor watched by the loop */
+typedef struct{
+	/**\brief File descriptor, -1 if the slot is free */
+	int fd;
+	/**\brief Incremented on reuse, stale events are dropped */
+	uint32_t gen;
+	/**\brief Event handler */
+	/*@null@*/ evloop_fd_func func;
+	/**\brief Handler data */
+	/*@null@*//*@dependent@*/ void *data;
+} evloop_source_s;
+
+/**\brief Loop state */
+typedef struct{
+	/**\brief epoll set */
+	int epfd;
+	/**\brief Deadline timer */
+	int timerfd;
+	/**\brief Clock of the deadline timer */
+	clockid_t timerclock;
+	/**\brief Cancelled when the system time is set, -1 if unsupported */
+	int clockfd;
+	/**\brief Exit and reload signals */
+	int sigfd;
+	/**\brief Signals blocked by the loop */
+	sigset_t sigs;
+	/**\brief Signal mask before evloop_init() */
+	sigset_t oldsigs;
+	/**\brief oldsigs holds the mask to restore */
+	int blocked;
+	/**\brief Deadline handler */
+	/*@null@*/ evloop_timer_func on_timer;
+	/**\brief Signal handler */
+	/*@null@*/ evloop_signal_func on_signal;
+	/**\brief Clock jump handler */
+	/*@null@*/ evloop_clock_func on_clock;
+	/**\brief Clock jump detector */
+	systemtime_watch_s watch;
+	/**\brief Set by the clock timer during a wakeup */
+	int clock_set;
+	/**\brief Handler data */
+	/*@null@*//*@dependent@*/ void *data;
+	/**\brief Set by evloop_quit() */
+	int quit;
+	/**\brief Added file descriptors */
+	evloop_source_s sources[EVLOOP_MAX_SOURCES];
+	/**\brief Statistics */
+	evloop_stats_s stats;
+} evloop_s;
+
+static evloop_s loop = {-1,-1,CLOCK_MONOTONIC,-1,-1};
+
+// Adds a descriptor to the epoll set
+static int evloop_watch(int fd, uint64_t tag){
+	struct epoll_event ev;
+
+	memset(&ev,0,sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.u64 = tag;
+	if( epoll_ctl(loop.epfd,EPOLL_CTL_ADD,fd,&ev)!=0 ){
+		LOG(LOGERR,_("Unable to watch file descriptor %d: %s"),fd,
+				strerror(errno));
+		return RET_FUN_FAILED;
+	}
+	return RET_FUN_SUCCESS;
+}
+
+// Arms the clock timer, it is cancelled when the system time is set
+static int evloop_arm_clock(void){
+	struct itimerspec spec;
+	struct timespec now;
+
+	// Any absolute time in the future will do, relative to now so that it
+	// stays representable
+	memset(&spec,0,sizeof(spec));
+	if( clock_gettime(CLOCK_REALTIME,&now)!=0 )
+		return RET_FUN_FAILED;
+	spec.it_value.tv_sec = now.tv_sec+CLOCK_SPAN;
+	return timerfd_settime(loop.clockfd,
+			TFD_TIMER_ABSTIME|TFD_TIMER_CANCEL_ON_SET,&spec,NULL)==0;
+}
+
+/* Creates the loop */
+int evloop_init(evloop_timer_func on_timer, evloop_signal_func on_signal,
+		evloop_clock_func on_clock, void *data){
+	int i;
+
+	evloop_end();
+	memset(&loop.stats,0,sizeof(loop.stats));
+	for( i=0; i<EVLOOP_MAX_SOURCES; ++i ){
+		loop.sources[i].fd = -1;
+		loop.sources[i].func = NULL;
+		loop.sources[i].data = NULL;
+	}
+	loop.on_timer = on_timer;
+	loop.on_signal = on_signal;
+	loop.on_clock = on_clock;
+	loop.data = data;
+	loop.clock_set = 0;
+	(void)systemtime_watch_init(&loop.watch);
+	loop.quit = 0;
+
+	// Signals are only delivered through the signalfd from now on
+	(void)sigemptyset(&loop.sigs);
+	(void)sigaddset(&loop.sigs,SIGINT);
+	(void)sigaddset(&loop.sigs,SIGTERM);
+	(void)sigaddset(&loop.sigs,SIGHUP);
+	if( sigprocmask(SIG_BLOCK,&loop.sigs,&loop.oldsigs)!=0 ){
+		LOG(LOGERR,_("Unable to block signals: %s"),strerror(errno));
+		return RET_FUN_FAILED;
+	}
+	loop.blocked = 1;
+	loop.epfd = epoll_create1(EPOLL_CLOEXEC);
+	// Suspended time counts so that deadlines passed while asleep fire on
+	// resume, CLOCK_BOOTTIME needs Linux 2.6.39
+	loop.timerclock = CLOCK_BOOTTIME;
+	loop.timerfd = timerfd_create(loop.timerclock,TFD_NONBLOCK|TFD_CLOEXEC);
+	if( loop.timerfd<0 ){
+		loop.timerclock = CLOCK_MONOTONIC;
+		loop.timerfd = timerfd_create(loop.timerclock,
+				TFD_NONBLOCK|TFD_CLOEXEC);
+	}
+	loop.sigfd = signalfd(-1,&loop.sigs,SFD_NONBLOCK|SFD_CLOEXEC);
+	if( (loop.epfd<0) || (loop.timerfd<0) || (loop.sigfd<0) ){
+		LOG(LOGERR,_("Unable to create event loop: %s"),strerror(errno));
+		evloop_end();
+		return RET_FUN_FAILED;
+	}
+	if( !evloop_watch(loop.timerfd,TAG_TIMER)
+			|| !evloop_watch(loop.sigfd,TAG_SIGNAL) ){
+		evloop_end();
+		return RET_FUN_FAILED;
+	}
+	// Without it, clock changes are noticed on the next wakeup (Linux 3.0)
+	loop.clockfd = timerfd_create(CLOCK_REALTIME,TFD_NONBLOCK|TFD_CLOEXEC);
+	if( (loop.clockfd>=0)
+			&& (!evloop_arm_clock() || !evloop_watch(loop.clockfd,TAG_CLOCK)) ){
+		(void)close(loop.clockfd);
+		loop.clockfd = -1;
+	}
+	if( loop.clockfd<0 )
+		LOG(LOGVERBOSE,_("Clock changes are not signalled"));
+	return RET_FUN_SUCCESS;
+}
+
+/* Closes the loop */
+void evloop_end(void){
+	struct signalfd_siginfo info;
+
+	// Any of them may have failed on its own in evloop_init()
+	if( loop.epfd>=0 )
+		(void)close(loop.epfd);
+	if( loop.timerfd>=0 )
+		(void)close(loop.timerfd);
+	if( loop.clockfd>=0 )
+		(void)close(loop.clockfd);
+	if( loop.sigfd>=0 ){
+		// Unblocking a pending signal would kill us with the default action
+		while( read(loop.sigfd,&info,sizeof(info))==(ssize_t)sizeof(info) );
+		(void)close(loop.sigfd);
+	}
+	loop.epfd = -1;
+	loop.timerfd = -1;
+	loop.clockfd = -1;
+	loop.sigfd = -1;
+	if( loop.blocked )
+		(void)sigprocmask(SIG_SETMASK,&loop.oldsigs,NULL);
+	loop.blocked = 0;
+}
+
+/* Watches a file descriptor */
+int evloop_add(int fd, evloop_fd_func func, void *data){
+	int i;
+
+	for( i=0; (i<EVLOOP_MAX_SOURCES) && (loop.sources[i].fd>=0); ++i );
+	if( i==EVLOOP_MAX_SOURCES ){
+		LOG(LOGERR,_("Too many event sources"));
+		return RET_FUN_FAILED;
+	}
+	++loop.sources[i].gen;
+	if( !evloop_watch(fd,((uint64_t)loop.sources[i].gen<<32)|(uint64_t)i) )
+		return RET_FUN_FAILED;
+	loop.sources[i].fd = fd;
+	loop.sources[i].func = func;
+	loop.sources[i].data = data;
+	return RET_FUN_SUCCESS;
+}
+
+/* Stops watching a file descriptor */
+int evloop_remove(int fd){
+	int i;
+
+	for( i=0; i<EVLOOP_MAX_SOURCES; ++i ){
+		if( loop.sources[i].fd!=fd )
+			continue;
+		(void)epoll_ctl(loop.epfd,EPOLL_CTL_DEL,fd,NULL);
+		loop.sources[i].fd = -1;
+		loop.sources[i].func = NULL;
+		loop.sources[i].data = NULL;
+		return RET_FUN_SUCCESS;
+	}
+	return RET_FUN_FAILED;
+}
+
+/* Sets the deadline */
+int evloop_set_deadline(double deadline){
+	struct itimerspec spec;
+	struct timespec mono;
+	struct timespec timer;
+
+	memset(&spec,0,sizeof(spec));
+	if( deadline>=0.0 ){
+		// Move the deadline onto the timer clock
+		if( (loop.timerclock!=CLOCK_MONOTONIC)
+				&& (clock_gettime(CLOCK_MONOTONIC,&mono)==0)
+				&& (clock_gettime(loop.timerclock,&timer)==0) )
+			deadline += (double)(timer.tv_sec-mono.tv_sec)
+				+(double)(timer.tv_nsec-mono.tv_nsec)/1000000000.0;
+		/*@i@*/spec.it_value.tv_sec = (time_t)deadline;
+		/*@i@*/spec.it_value.tv_nsec = (long)((deadline
+					-(double)spec.it_value.tv_sec)*1000000000.0);
+		if( spec.it_value.tv_nsec>999999999L )
+			spec.it_value.tv_nsec = 999999999L;
+		// All zero would disarm, the deadline has passed anyway
+		if( (spec.it_value.tv_sec==0) && (spec.it_value.tv_nsec==0) )
+			spec.it_value.tv_nsec = 1;
+	}
+	if( timerfd_settime(loop.timerfd,TFD_TIMER_ABSTIME,&spec,NULL)!=0 ){
+		LOG(LOGERR,_("Unable to set event loop deadline: %s"),
+				strerror(errno));
+		return RET_FUN_FAILED;
+	}
+	return RET_FUN_SUCCESS;
+}
+
+// Reads the expiry count of the timer
+static void evloop_timer_ready(void){
+	uint64_t expired;
+
+	if( read(loop.timerfd,&expired,sizeof(expired))!=(ssize_t)sizeof(expired) )
+		return;
+	++loop.stats.timers;
+	if( loop.on_timer )
+		loop.on_timer(loop.data);
+}
+
+// Notes that the system time was set and rearms the clock timer
+static void evloop_clock_ready(void){
+	uint64_t expired;
+
+	if( read(loop.clockfd,&expired,sizeof(expired))==(ssize_t)sizeof(expired) )
+		// Ran for CLOCK_SPAN without the time being set
+		(void)evloop_arm_clock();
+	else if( errno==ECANCELED ){
+		loop.clock_set = 1;
+		(void)evloop_arm_clock();
+	}
+}
+
+// Reads all pending signals
+static void evloop_signal_ready(void){
+	struct signalfd_siginfo info;
+
+	while( read(loop.sigfd,&info,sizeof(info))==(ssize_t)sizeof(info) ){
+		++loop.stats.signals;
+		LOG(LOGINFO,_("Detected signal: %d"),(int)info.ssi_signo);
+		if( loop.on_signal )
+			loop.on_signal((int)info.ssi_signo,loop.data);
+	}
+}
+
+/* Waits once and dispatches */
+int evloop_dispatch(int timeout_ms){
+	struct epoll_event evs[EVLOOP_MAX_EVENTS];
+	evloop_source_s *src;
+	double jump;
+	uint32_t slot;
+	int events;
+	int n;
+	int i;
+
+	n = epoll_wait(loop.epfd,evs,EVLOOP_MAX_EVENTS,timeout_ms);
+	if( n<0 ){
+		if( errno==EINTR )
+			return 0;
+		LOG(LOGERR,_("Event loop wait failed: %s"),strerror(errno));
+		return -1;
+	}
+	++loop.stats.wakeups;
+	for( i=0; i<n; ++i ){
+		slot = (uint32_t)(evs[i].data.u64 & 0xffffffffu);
+		if( slot==TAG_TIMER ){
+			evloop_timer_ready();
+			continue;
+		}
+		if( slot==TAG_SIGNAL ){
+			evloop_signal_ready();
+			continue;
+		}
+		if( slot==TAG_CLOCK ){
+			evloop_clock_ready();
+			continue;
+		}
+		src = &loop.sources[slot];
+		// Removed or replaced by an earlier handler of this batch
+		if( (src->fd<0) || (src->gen!=(uint32_t)(evs[i].data.u64>>32))
+				|| (src->func==NULL) )
+			continue;
+		events = 0;
+		if( evs[i].events & EPOLLIN )
+			events |= EVLOOP_IN;
+		if( evs[i].events & (EPOLLERR|EPOLLHUP) )
+			events |= EVLOOP_ERR;
+		++loop.stats.fds;
+		src->func(src->fd,events,src->data);
+	}
+	// Once per wakeup, after the deadline handler which may have just
+	// woken up from a suspend
+	if( systemtime_watch_check(&loop.watch,&jump) || loop.clock_set ){
+		loop.clock_set = 0;
+		++loop.stats.clock_jumps;
+		LOG(LOGINFO,_("System time jumped by %.0fs"),jump);
+		if( loop.on_clock )
+			loop.on_clock(jump,loop.data);
+	}
+	return n;
+}
+
+/* Dispatches until evloop_quit() */
+int evloop_run(void){
+	loop.quit = 0;
+	while( !loop.quit ){
+		if( evloop_dispatch(-1)<0 )
+			return RET_FUN_FAILED;
+	}
+	return RET_FUN_SUCCESS;
+}
+
+/* Stops evloop_run() */
+void evloop_quit(void){
+	loop.quit = 1;
+}
+
+/* Retrieves loop statistics */
+void evloop_get_stats(evloop_stats_s *stats){
+	*stats = loop.stats;
+}
+
+#endif /* HAVE_EVLOOP */
@@ -0,0 +1,110 @@
+/**\file		evloop.h
+ * \brief		Event loop of the console daemon.
+ * \details
+ * One epoll set multiplexes every event source of the daemon: a timerfd
+ * for the next deadline on the monotonic clock, a signalfd for SIGINT,
+ * SIGTERM and SIGHUP, and any file descriptor added with evloop_add()
+ * (display connection, sockets, ...).  Sources live in a fixed table and
+ * events are read into stack buffers, so the loop does not allocate once
+ * it is running.  Only built where epoll, timerfd and signalfd exist
+ * (HAVE_EVLOOP).
+ *
+ * Jumps of the system time, whether set by hand, stepped by NTP or skipped
+ * while suspended, are reported once per wakeup.  The deadline timer counts
+ * suspended time (CLOCK_BOOTTIME where available) so that it fires on
+ * resume, and a CLOCK_REALTIME timerfd cancelled on clock changes wakes the
+ * loop as soon as the time is set.
+ */
+
+#ifndef __EVLOOP_H__
+#define __EVLOOP_H__
+#ifdef HAVE_EVLOOP
+
+/**\brief Maximum number of file descriptors added with evloop_add() */
+#define EVLOOP_MAX_SOURCES	16
+/**\brief Maximum number of events handled per wakeup */
+#define EVLOOP_MAX_EVENTS	16
+
+/**\brief Readable event */
+#define EVLOOP_IN	0x1
+/**\brief Error or hang up event */
+#define EVLOOP_ERR	0x2
+
+/**\brief Handles events of a file descriptor
+ * \param fd file descriptor
+ * \param events EVLOOP_IN and/or EVLOOP_ERR
+ * \param data pointer given to evloop_add()
+ */
+typedef void (*evloop_fd_func)(int fd, int events, /*@null@*/ void *data);
+
+/**\brief Handles the expiry of the deadline */
+typedef void (*evloop_timer_func)(/*@null@*/ void *data);
+
+/**\brief Handles SIGINT, SIGTERM or SIGHUP */
+typedef void (*evloop_signal_func)(int signo, /*@null@*/ void *data);
+
+/**\brief Handles a jump of the system time
+ * \param jump seconds the system time moved against the monotonic clock,
+ * 0 if it was set without moving noticeably
+ */
+typedef void (*evloop_clock_func)(double jump, /*@null@*/ void *data);
+
+/**\brief Event loop statistics */
+typedef struct{
+	/**\brief Number of returns from epoll_wait */
+	unsigned long wakeups;
+	/**\brief Number of deadline expiries */
+	unsigned long timers;
+	/**\brief Number of signals */
+	unsigned long signals;
+	/**\brief Number of file descriptor events */
+	unsigned long fds;
+	/**\brief Number of clock jumps */
+	unsigned long clock_jumps;
+} evloop_stats_s;
+
+/**\brief Creates the loop and blocks the signals it handles
+ * \param on_timer called when the deadline expires
+ * \param on_signal called for each signal received
+ * \param on_clock called after the events of a wakeup if the clock jumped
+ * \param data passed to all three
+ */
+int evloop_init(evloop_timer_func on_timer, evloop_signal_func on_signal,
+		evloop_clock_func on_clock, /*@null@*/ void *data);
+
+/**\brief Closes the loop and unblocks the signals */
+void evloop_end(void);
+
+/**\brief Watches a file descriptor for input
+ * \return RET_FUN_FAILED if the table is full or epoll refuses the fd
+ */
+int evloop_add(int fd, evloop_fd_func func, /*@null@*/ void *data);
+
+/**\brief Stops watching a file descriptor */
+int evloop_remove(int fd);
+
+/**\brief Sets the deadline
+ * \param deadline absolute time from systemtime_get_monotonic(), negative
+ * to disarm.  A deadline in the past expires on the next wait.
+ */
+int evloop_set_deadline(double deadline);
+
+/**\brief Waits once and dispatches all ready events
+ * \param timeout_ms maximum wait in milliseconds, -1 to wait forever
+ * \return number of events dispatched, -1 on error
+ */
+int evloop_dispatch(int timeout_ms);
+
+/**\brief Dispatches events until evloop_quit() is called
+ * \return RET_FUN_FAILED on error
+ */
+int evloop_run(void);
+
+/**\brief Makes evloop_run() return after the current dispatch */
+void evloop_quit(void);
+
+/**\brief Retrieves loop statistics */
+void evloop_get_stats(/*@out@*/ evloop_stats_s *stats);
+
+#endif /* HAVE_EVLOOP */
+#endif//__EVLOOP_H__
@@ -0,0 +1,197 @@
+#include "common.h"
+#ifdef HAVE_EVLOOP
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include "status.h"
+#include "follow.h"
+
+/* Line formats, the same fields in the same order */
+static const char *follow_formats[] = {
+	"{\"time\":%.3f,\"temp\":%d,\"target\":%d,\"bright\":%.2f,"
+		"\"elevation\":%.2f,\"mode\":\"%s\",\"paused\":%d}\n",
+	"%.3f\t%d\t%d\t%.2f\t%.2f\t%s\t%d\n"
+};
+static const char *follow_format_names[] = {"json","tsv"};
+
+/**\brief Follow state */
+typedef struct{
+	/**\brief Following? */
+	int active;
+	/**\brief Output, -1 while a FIFO has no reader */
+	int fd;
+	/**\brief Index in follow_formats */
+	int format;
+	/**\brief Minimum time between lines */
+	double interval;
+	/**\brief Earliest time of the next line */
+	double next;
+	/**\brief A change waits for the interval to pass? */
+	int pending;
+	/**\brief State of the last line */
+	status_s last;
+	/**\brief Latest state while pending */
+	status_s latest;
+	/**\brief Number of lines written */
+	unsigned long lines;
+	/**\brief Number of lines a slow reader had no room for yet */
+	unsigned long deferred;
+	/**\brief Output path, empty for standard output */
+	char path[LONGEST_PATH];
+	/**\brief Line buffer */
+	char line[FOLLOW_LINE_MAX];
+} follow_s;
+
+static follow_s follow = {0,-1};
+
+// Opens the output path, a FIFO without reader fails with ENXIO
+static int follow_open(void){
+	follow.fd = open(follow.path,
+			O_WRONLY|O_APPEND|O_CREAT|O_NONBLOCK|O_CLOEXEC,
+			S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
+	return (follow.fd>=0);
+}
+
+// Whether a change is worth a line, the elevation moves all the time
+static int follow_changed(const status_s *a, const status_s *b){
+	return (a->temp!=b->temp) || (a->target!=b->target)
+		|| (a->brightness!=b->brightness) || (a->mode!=b->mode)
+		|| (a->paused!=b->paused);
+}
+
+// Writes one line, RET_FUN_FAILED if the reader had no room for it
+static int follow_write(const status_s *state){
+	int len;
+	ssize_t n;
+
+	// Without a reader the next change opens the FIFO again
+	if( (follow.fd<0) && !follow_open() )
+		return RET_FUN_SUCCESS;
+	len = snprintf(follow.line,sizeof(follow.line),
+			follow_formats[follow.format],state->updated,state->temp,
+			state->target,state->brightness,state->elevation,
+			status_mode_name(state->mode),state->paused);
+	if( (len<0) || ((size_t)len>=sizeof(follow.line)) )
+		return RET_FUN_SUCCESS;
+	// Lines are shorter than PIPE_BUF, a pipe takes them whole or not at all
+	n = write(follow.fd,follow.line,(size_t)len);
+	if( n==(ssize_t)len ){
+		follow.last = *state;
+		++follow.lines;
+		return RET_FUN_SUCCESS;
+	}
+	if( (n<0) && (errno==EAGAIN) ){
+		++follow.deferred;
+		return RET_FUN_FAILED;
+	}
+	// Reader gone
+	(void)close(follow.fd);
+	follow.fd = -1;
+	if( follow.path[0]=='\0' ){
+		LOG(LOGWARN,_("Follow output closed"));
+		follow.active = 0;
+	}
+	return RET_FUN_SUCCESS;
+}
+
+/* Starts following */
+int follow_init(const char *format, const char *path, double rate){
+	struct stat st;
+	int i;
+
+	for( i=0; (i<(int)(sizeof(follow_format_names)/sizeof(char*)))
+			&& (strcmp(format,follow_format_names[i])!=0); ++i );
+	if( i==(int)(sizeof(follow_format_names)/sizeof(char*)) ){
+		LOG(LOGERR,_("Unknown follow format: %s (json, tsv)"),format);
+		return RET_FUN_FAILED;
+	}
+	if( rate<0.0 ){
+		LOG(LOGERR,_("Invalid follow rate: %f"),rate);
+		return RET_FUN_FAILED;
+	}
+	follow.format = i;
+	follow.interval = (rate>0.0) ? 1.0/rate : 0.0;
+	follow.next = 0.0;
+	follow.pending = 0;
+	follow.lines = 0;
+	follow.deferred = 0;
+	memset(&follow.last,0,sizeof(follow.last));
+	// A reader closing its end must not kill the daemon
+	(void)signal(SIGPIPE,SIG_IGN);
+	if( path ){
+		if( strlen(path)>=sizeof(follow.path) ){
+			LOG(LOGERR,_("Follow path too long"));
+			return RET_FUN_FAILED;
+		}
+		strcpy(follow.path,path);
+		if( !follow_open() ){
+			if( errno!=ENXIO ){
+				LOG(LOGERR,_("Unable to open %s: %s"),path,strerror(errno));
+				return RET_FUN_FAILED;
+			}
+			LOG(LOGVERBOSE,_("No reader on %s yet"),path);
+		}
+	}else{
+		// Keep standard output for the lines, log messages go to stderr
+		(void)fflush(stdout);
+		follow.path[0] = '\0';
+		follow.fd = dup(STDOUT_FILENO);
+		if( (follow.fd<0) || (dup2(STDERR_FILENO,STDOUT_FILENO)<0) ){
+			LOG(LOGERR,_("Unable to follow on standard output: %s"),
+					strerror(errno));
+			if( follow.fd>=0 )
+				(void)close(follow.fd);
+			follow.fd = -1;
+			return RET_FUN_FAILED;
+		}
+		(void)fcntl(follow.fd,F_SETFD,FD_CLOEXEC);
+		// Only a pipe is ours alone to make non-blocking
+		if( (fstat(follow.fd,&st)==0) && S_ISFIFO(st.st_mode) )
+			(void)fcntl(follow.fd,F_SETFL,O_NONBLOCK);
+	}
+	follow.active = 1;
+	return RET_FUN_SUCCESS;
+}
+
+/* Stops following */
+void follow_end(void){
+	if( !follow.active && (follow.fd<0) )
+		return;
+	if( follow.active && follow.pending )
+		(void)follow_write(&follow.latest);
+	LOG(LOGVERBOSE,_("Followed %lu changes, %lu lines deferred"),
+			follow.lines,follow.deferred);
+	if( follow.fd>=0 )
+		(void)close(follow.fd);
+	follow.fd = -1;
+	follow.active = 0;
+	follow.pending = 0;
+}
+
+/* Writes a line if the state changed */
+double follow_update(const status_s *state, double now){
+	if( !follow.active )
+		return -1.0;
+	if( !follow_changed(state,&follow.last) ){
+		follow.pending = 0;
+		return -1.0;
+	}
+	// Coalesce into the line due at the end of the interval
+	if( now<follow.next ){
+		follow.latest = *state;
+		follow.pending = 1;
+		return follow.next;
+	}
+	follow.pending = 0;
+	follow.next = now+follow.interval;
+	if( follow_write(state) )
+		return -1.0;
+	// The reader is behind, try again with the then latest state
+	follow.next = now+MAX(follow.interval,FOLLOW_RETRY);
+	follow.latest = *state;
+	follow.pending = 1;
+	return follow.next;
+}
+
+#endif /* HAVE_EVLOOP */
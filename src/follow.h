@@ -0,0 +1,54 @@
+/**\file		follow.h
+ * \brief		State change lines for push based consumers.
+ * \details
+ * With --follow the console daemon writes one line each time the
+ * temperature on screen, the target, the brightness, the mode or the pause
+ * reasons change, either as JSON:
+ *
+ *   {"time":1282550400.250,"temp":4375,"target":3400,"bright":1.00,
+ *    "elevation":-2.31,"mode":"auto","paused":0}
+ *
+ * or tab separated in the same order.  During transitions changes are
+ * coalesced to at most --followhz lines per second, the line written when
+ * the interval is up carries the latest state.
+ *
+ * Lines go to the original standard output, log messages move to standard
+ * error meanwhile, or to --followto, typically a FIFO.  Writes never block
+ * the daemon: when a slow reader has no room for a line, the latest state
+ * is written at the next interval instead, so the last change always
+ * arrives, and a FIFO nobody reads is opened again on the next change.
+ * Lines are formatted into a static buffer and written with one system
+ * call, without allocating.  Only built with HAVE_EVLOOP.
+ */
+
+#ifndef __FOLLOW_H__
+#define __FOLLOW_H__
+#ifdef HAVE_EVLOOP
+
+/**\brief Longest line */
+#define FOLLOW_LINE_MAX		256
+/**\brief Default maximum number of lines per second */
+#define FOLLOW_DEFAULT_RATE	10.0
+/**\brief Seconds before writing to a full pipe again without a rate limit */
+#define FOLLOW_RETRY		0.1
+
+/**\brief Starts following
+ * \param format "json" or "tsv"
+ * \param path file or FIFO to write to, NULL for standard output
+ * \param rate maximum number of lines per second, 0 for no limit
+ */
+int follow_init(const char *format, /*@null@*/ const char *path, double rate);
+
+/**\brief Writes what is still pending and stops following */
+void follow_end(void);
+
+/**\brief Writes a line if the state changed
+ * \param state state as published to the status segment (status.h)
+ * \param now monotonic time in seconds
+ * \return time at which a coalesced change is due, negative if nothing is
+ * pending.  Call again with the then current state at that time.
+ */
+double follow_update(const status_s *state, double now);
+
+#endif /* HAVE_EVLOOP */
+#endif//__FOLLOW_H__
@@ -1,8 +1,10 @@
 #include "common.h"
+#include <float.h>
 #include "gamma.h"
 #include "options.h"
 #include "solar.h"
 #include "systemtime.h"
+#include "gamma_simd.h"
 
 #if !(defined(ENABLE_RANDR) ||			\
       defined(ENABLE_VIDMODE) ||		\
@@ -20,10 +22,131 @@
 #define TRANSITION_LOW     SOLAR_CIVIL_TWILIGHT_ELEV
 #define TRANSITION_HIGH    3.0f
 
+/* Scan step in seconds when looking for the next target change, the sun
+   moves at most 0.25 degrees in that time */
+#define NEXT_CHANGE_SCAN	60.0
+/* Precision of the next target change in seconds */
+#define NEXT_CHANGE_PRECISION	1.0
+
 static gamma_method_s methods[GAMMA_METHOD_MAX];
 static gamma_s default_gam = {DEFAULT_GAMMA,DEFAULT_GAMMA,DEFAULT_GAMMA};
 static gamma_method_t active_method=GAMMA_METHOD_NONE;
-static gamma_ramp_s ramp = {NULL,NULL,NULL,NULL,0};
+
+/**\brief Number of idle ramp buffers kept for reuse */
+#define GAMMA_POOL_SIZE 16
+/* Idle ramp buffers, keyed by their size */
+static gamma_ramp_s pool[GAMMA_POOL_SIZE];
+
+/**\brief Cached shaping curve (i/size)^exponent */
+typedef struct{
+	/**\brief Curve values */
+	/*@null@*//*@owned@*/ float *data;
+	/**\brief Number of entries */
+	int size;
+	/**\brief Exponent the curve was built with */
+	float exponent;
+} gamma_curve_s;
+
+/* One shaping curve per channel, rebuilt only when size or tweak changes */
+static gamma_curve_s curves[3] = {{NULL,0,0.0f},{NULL,0,0.0f},{NULL,0,0.0f}};
+
+/**\brief Inverse white point index */
+typedef struct{
+	/**\brief Table the index was built from */
+	/*@null@*//*@dependent@*/ const temp_gamma *table;
+	/**\brief Number of entries */
+	int size;
+	/**\brief Red/blue ratio per entry, non increasing */
+	/*@null@*//*@owned@*/ float *ratio;
+} gamma_index_s;
+
+/* Built on first lookup, dropped when the white point table changes */
+static gamma_index_s inv_index = {NULL,0,NULL};
+
+/* Current refresh generation, commits from older ones are stale */
+static unsigned int commit_gen = 1;
+/* Number of ramp writes skipped because nothing changed */
+static unsigned long commit_skipped = 0;
+
+/**\brief Paused ramp writes */
+typedef struct{
+	/**\brief GAMMA_PAUSE_* reasons in effect, 0 if writing */
+	int reasons;
+	/**\brief Last temperature requested, 0 if none yet */
+	int temp;
+	/**\brief Last temperature written, 0 if none yet */
+	int shown;
+	/**\brief Gamma requested with it */
+	gamma_s gamma;
+	/**\brief Number of writes suppressed */
+	unsigned long suppressed;
+	/**\brief Result of the write on resume, -1 if none */
+	int resumed;
+} gamma_pause_s;
+
+static gamma_pause_s paused = {0,0,0,{1.0f,1.0f,1.0f},0,-1};
+
+/**\brief Smallest ramp value used when fitting a read back ramp */
+#define GAMMA_FIT_MIN 64.0f
+/**\brief Minimum number of samples per channel for a fit */
+#define GAMMA_FIT_SAMPLES 8
+
+/**\brief Ramp cache entry */
+typedef struct _gamma_cache_entry{
+	/**\brief Temperature */
+	int temp;
+	/**\brief Brightness */
+	float brightness;
+	/**\brief Gamma tweak */
+	gamma_s tweak;
+	/**\brief Ramps, size entries per channel */
+	gamma_ramp_s ramp;
+	/**\brief More recently used entry */
+	/*@null@*//*@dependent@*/ struct _gamma_cache_entry *prev;
+	/**\brief Less recently used entry */
+	/*@null@*//*@owned@*/ struct _gamma_cache_entry *next;
+} gamma_cache_entry_s;
+
+/* LRU ramp cache, head is the most recently used entry */
+static /*@null@*/ gamma_cache_entry_s *cache_head = NULL;
+static /*@null@*/ gamma_cache_entry_s *cache_tail = NULL;
+static gamma_cache_stats_s cache_stats = {0,0,0,0,0,DEFAULT_CACHE_SIZE*1024};
+
+/**\brief Maximum number of ramp sizes in the ladder */
+#define GAMMA_LADDER_SIZES 8
+/**\brief Maximum ladder arena size in bytes */
+#define GAMMA_LADDER_MAX_BYTES (16*1024*1024)
+
+/**\brief Ramps of every temperature of a transition, built up front */
+typedef struct{
+	/**\brief One allocation holding all ramps, by size then temperature */
+	/*@null@*//*@owned@*/ uint16_t *arena;
+	/**\brief Arena size in bytes */
+	size_t bytes;
+	/**\brief Temperatures, in transition order */
+	/*@null@*//*@owned@*/ int *temps;
+	/**\brief Number of temperatures */
+	int count;
+	/**\brief Ramp sizes built */
+	int sizes[GAMMA_LADDER_SIZES];
+	/**\brief Offset of the first ramp of each size in the arena */
+	size_t offsets[GAMMA_LADDER_SIZES];
+	/**\brief Number of ramp sizes built */
+	int nsizes;
+	/**\brief Brightness the ramps were built with */
+	float brightness;
+	/**\brief Gamma tweak the ramps were built with */
+	gamma_s tweak;
+	/**\brief Number of ramps served */
+	unsigned long hits;
+	/**\brief Arena could not be built, steps compute until the next build */
+	int failed;
+} gamma_ladder_s;
+
+static gamma_ladder_s ladder;
+/* Ramp sizes filled so far, the ladder is built for all of them */
+static int ladder_sizes[GAMMA_LADDER_SIZES];
+static int ladder_nsizes = 0;
 
 // Interpolates between two RGB colors
 static void gamma_interp_color(float a,
@@ -34,14 +157,41 @@ static void gamma_interp_color(float a,
 	c[2] = (1.0f-a)*c1.b + a*c2.b;
 }
 
+// Looks up white point, table resolution is taken from the table itself
+static int gamma_white_point(int temp, /*@out@*/ float *c){
+	int gmap_size;
+	temp_gamma *gam_map = opt_get_gammap(&gmap_size);
+	int step;
+	int offset;
+	int index;
+
+	c[0] = c[1] = c[2] = 1.0f;
+	if( gmap_size<2 )
+		return RET_FUN_FAILED;
+	step = gam_map[1].temp-gam_map[0].temp;
+	offset = temp-gam_map[0].temp;
+	if( (step<=0) || (offset<0) ){
+		LOG(LOGERR,_("Temperature %d outside of white point table"),temp);
+		return RET_FUN_FAILED;
+	}
+	index = offset/step;
+	if( index>=gmap_size-1 ){
+		gamma_interp_color(0.0f,gam_map[gmap_size-1].gamma,
+				gam_map[gmap_size-1].gamma,c);
+		return RET_FUN_SUCCESS;
+	}
+	// Table entries are exact when the resolution is fine enough
+	gamma_interp_color((float)(offset%step)/(float)step,
+			gam_map[index].gamma,gam_map[index+1].gamma,c);
+	return RET_FUN_SUCCESS;
+}
+
 // Frees gamma ramps
 static int gamma_free_ramps(gamma_ramp_s *_ramp)
 	/*@ensures isnull _ramp->all@*/
 {
-	if( _ramp->all ){
-		LOG(LOGINFO,_("Freeing previous ramp"));
+	if( _ramp->all )
 		free(_ramp->all);
-	}
 	_ramp->all = NULL;
 	_ramp->r = NULL;
 	_ramp->g = NULL;
@@ -50,62 +200,501 @@ static int gamma_free_ramps(gamma_ramp_s *_ramp)
 	return RET_FUN_SUCCESS;
 }
 
-// Re-allocates ramps if needed
-gamma_ramp_s gamma_get_ramps(int size)
-	/*@globals ramp@*/
+// Takes a ramp buffer from the pool, allocating only if none fits
+gamma_ramp_s gamma_pool_get(int size)
+	/*@globals pool@*/
 {
-	if( ramp.size != size ){
-		LOG(LOGINFO,_("New ramp size requested, allocating new ramps"));
-		if(gamma_free_ramps(&ramp)!=RET_FUN_SUCCESS)
-			return ramp;
-		ramp.all = (uint16_t*)malloc(sizeof(uint16_t)*3*size);
-		if( ramp.all==NULL ){
-			LOG(LOGERR,_("Unable to allocate new gamma ramps."));
-			return ramp;
+	int i;
+	gamma_ramp_s newramp = {NULL,NULL,NULL,NULL,0};
+	for( i=0; i<GAMMA_POOL_SIZE; ++i ){
+		if( (pool[i].all!=NULL) && (pool[i].size==size) ){
+			newramp = pool[i];
+			pool[i].all = NULL;
+			pool[i].size = 0;
+			return newramp;
 		}
-		ramp.r = ramp.all;
-		ramp.g = ramp.r+size;
-		ramp.b = ramp.g+size;
-		ramp.size = size;
 	}
-	return ramp;
+	LOG(LOGVERBOSE,_("Allocating ramp buffer of size %d"),size);
+	newramp.all = (uint16_t*)malloc(sizeof(uint16_t)*3*size);
+	if( newramp.all==NULL ){
+		LOG(LOGERR,_("Unable to allocate new gamma ramps."));
+		return newramp;
+	}
+	newramp.r = newramp.all;
+	newramp.g = newramp.r+size;
+	newramp.b = newramp.g+size;
+	newramp.size = size;
+	return newramp;
 }
 
-// Fill gamma ramp according to current parameters
-gamma_ramp_s gamma_ramp_fill(int size, int temp)
+// Returns a ramp buffer to the pool
+void gamma_pool_put(gamma_ramp_s *_ramp)
+	/*@globals pool@*/
+{
+	int i;
+	if( _ramp->all==NULL )
+		return;
+	for( i=0; i<GAMMA_POOL_SIZE; ++i ){
+		if( pool[i].all==NULL ){
+			pool[i] = *_ramp;
+			_ramp->all = NULL;
+			break;
+		}
+	}
+	(void)gamma_free_ramps(_ramp);
+}
+
+// Frees all idle ramp buffers
+void gamma_pool_clear(void)
+	/*@globals pool@*/
+{
+	int i;
+	for( i=0; i<GAMMA_POOL_SIZE; ++i )
+		(void)gamma_free_ramps(&pool[i]);
+}
+
+// Retrieves shaping curve for a channel, rebuilding only if needed
+static /*@null@*/ float *gamma_get_curve(int chan, int size, float exponent)
+	/*@globals curves@*/
+{
+	int i;
+	gamma_curve_s *c = &curves[chan];
+	if( (c->data!=NULL) && (c->size==size) && (c->exponent==exponent) )
+		return c->data;
+	// Share a curve with a previous channel if it has the same tweak
+	for( i=0; i<chan; ++i ){
+		if( (curves[i].data!=NULL) && (curves[i].size==size)
+				&& (curves[i].exponent==exponent) )
+			return curves[i].data;
+	}
+	if( c->size != size ){
+		if( c->data )
+			free(c->data);
+		c->size = 0;
+		c->data = (float*)malloc(sizeof(float)*size);
+		if( c->data==NULL ){
+			LOG(LOGERR,_("Unable to allocate curve buffer."));
+			return NULL;
+		}
+		c->size = size;
+	}
+	LOG(LOGVERBOSE,_("Building shaping curve %d (size %d, exponent %f)"),
+			chan,size,exponent);
+	gamma_simd_curve(c->data,size,exponent);
+	c->exponent = exponent;
+	return c->data;
+}
+
+// Frees cached shaping curves
+static void gamma_free_curves(void)
+	/*@globals curves@*/
+{
+	int i;
+	for( i=0; i<3; ++i ){
+		if( curves[i].data )
+			free(curves[i].data);
+		curves[i].data = NULL;
+		curves[i].size = 0;
+	}
+}
+
+// Memory used by a cache entry of given ramp size
+static size_t gamma_cache_entry_bytes(int size){
+	return sizeof(gamma_cache_entry_s)+sizeof(uint16_t)*3*(size_t)size;
+}
+
+// Removes entry from the LRU list
+static void gamma_cache_unlink(gamma_cache_entry_s *e)
+	/*@globals cache_head,cache_tail@*/
+{
+	if( e->prev )
+		e->prev->next = e->next;
+	else
+		cache_head = e->next;
+	if( e->next )
+		e->next->prev = e->prev;
+	else
+		cache_tail = e->prev;
+	e->prev = NULL;
+	e->next = NULL;
+}
+
+// Inserts entry as most recently used
+static void gamma_cache_push(gamma_cache_entry_s *e)
+	/*@globals cache_head,cache_tail@*/
+{
+	e->prev = NULL;
+	e->next = cache_head;
+	if( cache_head )
+		cache_head->prev = e;
+	cache_head = e;
+	if( !cache_tail )
+		cache_tail = e;
+}
+
+// Frees an unlinked entry
+static void gamma_cache_free_entry(/*@only@*/ gamma_cache_entry_s *e)
+	/*@globals cache_stats@*/
+{
+	cache_stats.bytes -= gamma_cache_entry_bytes(e->ramp.size);
+	--cache_stats.entries;
+	free(e->ramp.all);
+	free(e);
+}
+
+// Drops least recently used entries until extra bytes fit in the limit
+static void gamma_cache_trim(size_t extra)
+	/*@globals cache_tail,cache_stats@*/
+{
+	while( cache_tail && (cache_stats.bytes+extra > cache_stats.limit) ){
+		gamma_cache_entry_s *e = cache_tail;
+		gamma_cache_unlink(e);
+		gamma_cache_free_entry(e);
+		++cache_stats.evictions;
+	}
+}
+
+// Finds a cached ramp, moves it to the front on hit
+static /*@null@*/ gamma_cache_entry_s *gamma_cache_find(int size, int temp,
+		float brightness, gamma_s tweak)
+	/*@globals cache_head@*/
+{
+	gamma_cache_entry_s *e;
+	for( e=cache_head; e!=NULL; e=e->next ){
+		if( (e->temp==temp) && (e->ramp.size==size)
+				&& (e->brightness==brightness)
+				&& (e->tweak.r==tweak.r)
+				&& (e->tweak.g==tweak.g)
+				&& (e->tweak.b==tweak.b) ){
+			if( e!=cache_head ){
+				gamma_cache_unlink(e);
+				gamma_cache_push(e);
+			}
+			return e;
+		}
+	}
+	return NULL;
+}
+
+// Gets an unlinked entry for a new ramp, recycling the LRU entry if full
+static /*@null@*/ gamma_cache_entry_s *gamma_cache_new(int size)
+	/*@globals cache_tail,cache_stats@*/
+{
+	size_t bytes = gamma_cache_entry_bytes(size);
+	gamma_cache_entry_s *e;
+	if( bytes > cache_stats.limit )
+		return NULL;
+	// Recycle the oldest entry's buffers if it has the same size
+	if( cache_tail && (cache_tail->ramp.size==size)
+			&& (cache_stats.bytes+bytes > cache_stats.limit) ){
+		e = cache_tail;
+		gamma_cache_unlink(e);
+		++cache_stats.evictions;
+		return e;
+	}
+	gamma_cache_trim(bytes);
+	e = (gamma_cache_entry_s*)malloc(sizeof(gamma_cache_entry_s));
+	if( e==NULL )
+		return NULL;
+	e->ramp.all = (uint16_t*)malloc(sizeof(uint16_t)*3*size);
+	if( e->ramp.all==NULL ){
+		free(e);
+		return NULL;
+	}
+	e->ramp.r = e->ramp.all;
+	e->ramp.g = e->ramp.r+size;
+	e->ramp.b = e->ramp.g+size;
+	e->ramp.size = size;
+	e->prev = NULL;
+	e->next = NULL;
+	cache_stats.bytes += bytes;
+	++cache_stats.entries;
+	return e;
+}
+
+// 64 bit FNV-1a over the ramp values
+static uint64_t gamma_ramp_hash(const gamma_ramp_s *ramp){
+	uint64_t h = UINT64_C(14695981039346656037);
+	int i;
+	int n = 3*ramp->size;
+	for( i=0; i<n; ++i ){
+		h ^= ramp->all[i];
+		h *= UINT64_C(1099511628211);
+	}
+	return h;
+}
+
+// Checks whether a ramp has to be written
+int gamma_commit_needed(gamma_commit_s *commit, const gamma_ramp_s *ramp){
+	if( ramp->all==NULL )
+		return 1;
+	commit->pending = gamma_ramp_hash(ramp);
+	if( (commit->gen==commit_gen) && (commit->hash==commit->pending) ){
+		++commit_skipped;
+		return 0;
+	}
+	return 1;
+}
+
+// Records a successful write
+void gamma_commit_done(gamma_commit_s *commit){
+	commit->hash = commit->pending;
+	commit->gen = commit_gen;
+}
+
+// Invalidates all commit records
+void gamma_force_refresh(void){
+	// Skip 0, it marks records that never committed
+	if( ++commit_gen==0 )
+		commit_gen = 1;
+}
+
+// Retrieves number of skipped writes
+unsigned long gamma_commit_skipped(void){
+	return commit_skipped;
+}
+
+// Sets memory limit of the ramp cache
+void gamma_cache_set_limit(size_t bytes){
+	cache_stats.limit = bytes;
+	gamma_cache_trim(0);
+	LOG(LOGVERBOSE,_("Ramp cache limit: %lu bytes"),(unsigned long)bytes);
+}
+
+// Empties the ramp cache
+void gamma_cache_clear(void){
+	while( cache_head ){
+		gamma_cache_entry_s *e = cache_head;
+		gamma_cache_unlink(e);
+		gamma_cache_free_entry(e);
+	}
+}
+
+// Retrieves ramp cache statistics
+void gamma_cache_get_stats(gamma_cache_stats_s *stats){
+	*stats = cache_stats;
+}
+
+// Computes ramps into curr_ramp
+static int gamma_ramp_compute(gamma_ramp_s curr_ramp, int temp,
+		float brightness, gamma_s tweak)
 {
 	int i;
-	int gmap_size;
 	/* Calculate white point */
 	float white_point[3];
-	float alpha = (float)(temp % 100) / 100.0f;
-	int temp_index = ((temp - 1000) / 100);
-	float brightness = opt_get_brightness();
-	gamma_s tweak = opt_get_gamma();
-	gamma_ramp_s curr_ramp = gamma_get_ramps(size);
-	temp_gamma *gam_map = opt_get_gammap(&gmap_size);
+	float exponent[3];
+	uint16_t *channel[3];
+	float *shape;
 
-	gamma_interp_color(alpha, gam_map[temp_index].gamma,
-			  gam_map[temp_index+1].gamma, white_point);
+	if( !gamma_white_point(temp,white_point) )
+		return RET_FUN_FAILED;
 
 	LOG(LOGVERBOSE,_("Gamma brightness: %f"),brightness);
 	if( (curr_ramp.size==0) ||
 			(curr_ramp.r==NULL) ||
 			(curr_ramp.g==NULL) ||
 			(curr_ramp.b==NULL) )
-		return curr_ramp;
-	for (i = 0; i < size; i++) {
-		curr_ramp.r[i] = (uint16_t)(brightness*
-				(pow((float)i/size,1.0f/tweak.r)*
-		/*@i@*/	 UINT16_MAX * white_point[0]));
-		curr_ramp.g[i] = (uint16_t)(brightness*
-				(pow((float)i/size,1.0f/tweak.g)*
-		/*@i@*/	 UINT16_MAX * white_point[1]));
-		curr_ramp.b[i] = (uint16_t)(brightness*
-				(pow((float)i/size,1.0f/tweak.b)*
-		/*@i@*/	 UINT16_MAX * white_point[2]));
+		return RET_FUN_FAILED;
+	exponent[0] = 1.0f/tweak.r;
+	exponent[1] = 1.0f/tweak.g;
+	exponent[2] = 1.0f/tweak.b;
+	channel[0] = curr_ramp.r;
+	channel[1] = curr_ramp.g;
+	channel[2] = curr_ramp.b;
+	// Curves are cached, each step is only a multiply and convert pass
+	for (i = 0; i < 3; i++) {
+		if( (shape=gamma_get_curve(i,curr_ramp.size,exponent[i]))==NULL )
+			return RET_FUN_FAILED;
+		gamma_simd_scale(channel[i],shape,curr_ramp.size,
+		/*@i@*/	(float)(brightness*UINT16_MAX*white_point[i]));
 	}
-	return curr_ramp;
+	return RET_FUN_SUCCESS;
+}
+
+// Frees the ladder arena, keeps the temperatures
+static void gamma_ladder_free_arena(void)
+	/*@globals ladder@*/
+{
+	if( ladder.arena )
+		free(ladder.arena);
+	ladder.arena = NULL;
+	ladder.bytes = 0;
+	ladder.nsizes = 0;
+}
+
+// Builds ramps of every ladder temperature for all sizes seen
+static int gamma_ladder_alloc(void)
+	/*@globals ladder,ladder_sizes,ladder_nsizes@*/
+{
+	double start = 0.0;
+	double end = 0.0;
+	size_t bytes = 0;
+	gamma_ramp_s ramp;
+	int i;
+	int j;
+
+	gamma_ladder_free_arena();
+	if( (ladder.temps==NULL) || (ladder_nsizes==0) )
+		return RET_FUN_FAILED;
+	for( i=0; i<ladder_nsizes; ++i )
+		bytes += sizeof(uint16_t)*3*(size_t)ladder_sizes[i]*ladder.count;
+	if( bytes>GAMMA_LADDER_MAX_BYTES ){
+		LOG(LOGWARN,_("Transition ramps need %lu KB, building them per step"),
+				(unsigned long)(bytes/1024));
+		ladder.failed = 1;
+		return RET_FUN_FAILED;
+	}
+	ladder.arena = (uint16_t*)malloc(bytes);
+	if( ladder.arena==NULL ){
+		LOG(LOGERR,_("Unable to allocate transition ramps."));
+		ladder.failed = 1;
+		return RET_FUN_FAILED;
+	}
+	(void)systemtime_get_monotonic(&start);
+	ladder.bytes = bytes;
+	ladder.brightness = opt_get_brightness();
+	ladder.tweak = opt_get_gamma();
+	bytes = 0;
+	// Size outermost, the shaping curves are then built once per size
+	for( i=0; i<ladder_nsizes; ++i ){
+		ladder.sizes[i] = ladder_sizes[i];
+		ladder.offsets[i] = bytes/sizeof(uint16_t);
+		ramp.size = ladder_sizes[i];
+		for( j=0; j<ladder.count; ++j ){
+			ramp.all = ladder.arena+ladder.offsets[i]+(size_t)j*3*ramp.size;
+			ramp.r = ramp.all;
+			ramp.g = ramp.r+ramp.size;
+			ramp.b = ramp.g+ramp.size;
+			if( !gamma_ramp_compute(ramp,ladder.temps[j],
+						ladder.brightness,ladder.tweak) ){
+				gamma_ladder_free_arena();
+				return RET_FUN_FAILED;
+			}
+		}
+		bytes += sizeof(uint16_t)*3*(size_t)ramp.size*ladder.count;
+	}
+	ladder.nsizes = ladder_nsizes;
+	(void)systemtime_get_monotonic(&end);
+	LOG(LOGVERBOSE,_("Built %d transition ramps x %d sizes (%lu KB) in %.2fms"),
+			ladder.count,ladder.nsizes,(unsigned long)(ladder.bytes/1024),
+			(end-start)*1000.0);
+	return RET_FUN_SUCCESS;
+}
+
+// Finds a ramp in the ladder, building the ladder for a new size
+static /*@null@*/ const uint16_t *gamma_ladder_find(int size, int temp,
+		float brightness, gamma_s tweak)
+	/*@globals ladder,ladder_sizes,ladder_nsizes@*/
+{
+	int i;
+	int j;
+
+	for( i=0; (i<ladder_nsizes) && (ladder_sizes[i]!=size); ++i );
+	if( (i==ladder_nsizes) && (ladder_nsizes<GAMMA_LADDER_SIZES) )
+		ladder_sizes[ladder_nsizes++] = size;
+	// Decided once per transition, the warning is not repeated every step
+	if( (ladder.temps==NULL) || ladder.failed )
+		return NULL;
+	for( j=0; (j<ladder.count) && (ladder.temps[j]!=temp); ++j );
+	if( j==ladder.count )
+		return NULL;
+	if( (ladder.arena==NULL) || (ladder.brightness!=brightness)
+			|| (ladder.tweak.r!=tweak.r) || (ladder.tweak.g!=tweak.g)
+			|| (ladder.tweak.b!=tweak.b) || (ladder.nsizes!=ladder_nsizes) ){
+		// Settings changed or a new output showed up, rebuild everything
+		if( !gamma_ladder_alloc() )
+			return NULL;
+	}
+	for( i=0; (i<ladder.nsizes) && (ladder.sizes[i]!=size); ++i );
+	if( (i==ladder.nsizes) || (ladder.arena==NULL) )
+		return NULL;
+	++ladder.hits;
+	return ladder.arena+ladder.offsets[i]+(size_t)j*3*size;
+}
+
+// Builds ramps of all temperatures of a transition
+int gamma_ladder_build(const int *temps, int count){
+	gamma_ladder_free();
+	if( count<=0 )
+		return RET_FUN_SUCCESS;
+	ladder.temps = (int*)malloc(sizeof(int)*count);
+	if( ladder.temps==NULL )
+		return RET_FUN_FAILED;
+	memcpy(ladder.temps,temps,sizeof(int)*count);
+	ladder.count = count;
+	// Without a known size the ladder is built on the first fill
+	if( ladder_nsizes==0 )
+		return RET_FUN_SUCCESS;
+	return gamma_ladder_alloc();
+}
+
+// Frees the ladder
+void gamma_ladder_free(void){
+	gamma_ladder_free_arena();
+	if( ladder.temps )
+		free(ladder.temps);
+	ladder.temps = NULL;
+	ladder.count = 0;
+	ladder.failed = 0;
+}
+
+// Fill gamma ramp according to current parameters
+int gamma_ramp_fill(gamma_ramp_s *curr_ramp, int temp)
+{
+	float brightness = opt_get_brightness();
+	gamma_s tweak = opt_get_gamma();
+	int size = curr_ramp->size;
+	const uint16_t *built;
+	gamma_cache_entry_s *e;
+
+	if( (curr_ramp->all==NULL) || (size==0) )
+		return RET_FUN_FAILED;
+	built = gamma_ladder_find(size,temp,brightness,tweak);
+	if( built!=NULL ){
+		memcpy(curr_ramp->all,built,sizeof(uint16_t)*3*size);
+		return RET_FUN_SUCCESS;
+	}
+	e = gamma_cache_find(size,temp,brightness,tweak);
+	if( e!=NULL ){
+		++cache_stats.hits;
+		memcpy(curr_ramp->all,e->ramp.all,sizeof(uint16_t)*3*size);
+		return RET_FUN_SUCCESS;
+	}
+	++cache_stats.misses;
+	if( !gamma_ramp_compute(*curr_ramp,temp,brightness,tweak) )
+		return RET_FUN_FAILED;
+	// Cache is disabled or too small for this size if this fails
+	e = gamma_cache_new(size);
+	if( e!=NULL ){
+		memcpy(e->ramp.all,curr_ramp->all,sizeof(uint16_t)*3*size);
+		e->temp = temp;
+		e->brightness = brightness;
+		e->tweak = tweak;
+		gamma_cache_push(e);
+	}
+	return RET_FUN_SUCCESS;
+}
+
+// Derives a ramp from a master ramp by decimation
+int gamma_ramp_resample(const gamma_ramp_s *master, gamma_ramp_s *curr_ramp){
+	int i;
+	int stride;
+	int size = curr_ramp->size;
+	if( (master->all==NULL) || (curr_ramp->all==NULL) || (size==0)
+			|| (master->size % size) )
+		return RET_FUN_FAILED;
+	stride = master->size/size;
+	if( stride==1 ){
+		memcpy(curr_ramp->all,master->all,sizeof(uint16_t)*3*size);
+		return RET_FUN_SUCCESS;
+	}
+	// i/size == (i*stride)/master->size, so samples are exact
+	for( i=0; i<size; ++i ){
+		curr_ramp->r[i] = master->r[i*stride];
+		curr_ramp->g[i] = master->g[i*stride];
+		curr_ramp->b[i] = master->b[i*stride];
+	}
+	return RET_FUN_SUCCESS;
 }
 
 char *gamma_get_method_name(gamma_method_t method)
@@ -117,26 +706,177 @@ char *gamma_get_method_name(gamma_method_t method)
 		return "None";
 }
 
-int gamma_find_temp(float ratio){
+// Red/blue ratio of a white point, blue may be 0 at low temperatures
+static float gamma_rb_ratio(const gamma_s *c){
+	if( c->b<=0.0f )
+		return FLT_MAX;
+	return c->r/c->b;
+}
+
+// Builds the inverse index for the current white point table
+static /*@null@*/ gamma_index_s *gamma_get_index(void)
+	/*@globals inv_index@*/
+{
+	int size;
 	int i;
-	int gam_val_size;
-	temp_gamma *gam_map=opt_get_gammap(&gam_val_size);
-	float prev_ratio,curr_ratio;
+	const temp_gamma *table = opt_get_gammap(&size);
+
+	if( (inv_index.ratio!=NULL) && (inv_index.table==table)
+			&& (inv_index.size==size) )
+		return &inv_index;
+	if( inv_index.ratio )
+		free(inv_index.ratio);
+	inv_index.table = NULL;
+	inv_index.size = 0;
+	inv_index.ratio = (float*)malloc(sizeof(float)*size);
+	if( inv_index.ratio==NULL ){
+		LOG(LOGERR,_("Unable to allocate temperature index."));
+		return NULL;
+	}
+	inv_index.ratio[0] = gamma_rb_ratio(&table[0].gamma);
+	for( i=1; i<size; ++i ){
+		float r = gamma_rb_ratio(&table[i].gamma);
+		// Keep the index searchable even if a table wiggles
+		if( r>inv_index.ratio[i-1] ){
+			LOG(LOGVERBOSE,_("White point ratio not monotonic at %dK"),
+					table[i].temp);
+			r = inv_index.ratio[i-1];
+		}
+		inv_index.ratio[i] = r;
+	}
+	inv_index.table = table;
+	inv_index.size = size;
+	return &inv_index;
+}
+
+// Binary search of the inverse index
+static int gamma_ratio_to_temp(float ratio){
+	gamma_index_s *idx = gamma_get_index();
+	const float *r;
+	int lo,hi;
+	float prev,curr;
+	int step;
+
+	if( (idx==NULL) || (idx->table==NULL) || (idx->ratio==NULL)
+			|| !(ratio==ratio) )
+		return RET_FUN_FAILED;
+	r = idx->ratio;
+	if( ratio>=r[0] )
+		return idx->table[0].temp;
+	if( ratio<r[idx->size-1] )
+		return RET_FUN_FAILED;
+	// First entry with r[i]<=ratio, r[lo]>ratio holds throughout
+	lo = 0;
+	hi = idx->size-1;
+	while( hi-lo>1 ){
+		int mid = lo+(hi-lo)/2;
+		if( r[mid]<=ratio )
+			hi = mid;
+		else
+			lo = mid;
+	}
+	prev = r[lo];
+	curr = r[hi];
+	step = idx->table[hi].temp-idx->table[lo].temp;
+	if( prev==FLT_MAX )
+		return idx->table[hi].temp;
+	// Interpolate between the entries, the ratio drops as temp rises
+	return idx->table[lo].temp
+		+(int)((prev-ratio)/(prev-curr)*(float)step+0.5f);
+}
+
+/* Find temperature from red:blue ratio */
+int gamma_find_temp(float ratio){
+	int temp = gamma_ratio_to_temp(ratio);
 	LOG(LOGVERBOSE,_("R/B Ratio: %f"),ratio);
-	prev_ratio = (float)gam_map[0].gamma.r/(float)gam_map[0].gamma.b;
-	for(i=0; i<gam_val_size; ++i){
-		curr_ratio = (float)gam_map[i].gamma.r/(float)gam_map[i].gamma.b;
-		if( curr_ratio <= ratio ){
-			// Interpolate color based on ratio
-			int color = (int)((ratio-curr_ratio)/(prev_ratio-curr_ratio)*100
-				+i*100+1000);
-			LOG(LOGVERBOSE,_("Current col:%d"),color);
-			return color;
+	if( !temp ){
+		LOG(LOGERR,_("Unable to find color temperature"));
+		return RET_FUN_FAILED;
+	}
+	LOG(LOGVERBOSE,_("Current col:%d"),temp);
+	return temp;
+}
+
+/* Fits temperature, brightness and gamma to a ramp */
+int gamma_fit_ramp(const uint16_t *r, const uint16_t *g, const uint16_t *b,
+		int size, gamma_fit_s *fit)
+{
+	const uint16_t *channel[3];
+	float amp[3];
+	float slope[3];
+	float white_point[3];
+	double num=0.0;
+	double den=0.0;
+	int i;
+
+	channel[0] = r;
+	channel[1] = g;
+	channel[2] = b;
+	// log2(v) = log2(amp*UINT16_MAX) + slope*log2(i/size), per channel
+	for( i=0; i<3; ++i ){
+		gamma_simd_sums_s s;
+		double d;
+		gamma_simd_logsums(channel[i],size,GAMMA_FIT_MIN,&s);
+		d = s.n*s.sxx-s.sx*s.sx;
+		if( (s.n<GAMMA_FIT_SAMPLES) || (d<=0.0) )
+			return RET_FUN_FAILED;
+		slope[i] = (float)((s.n*s.sxy-s.sx*s.sy)/d);
+		amp[i] = (float)(pow(2.0,(s.sy-slope[i]*s.sx)/s.n)/UINT16_MAX);
+		if( slope[i]<=0.0f )
+			return RET_FUN_FAILED;
+	}
+	fit->temp = gamma_ratio_to_temp(amp[0]/amp[2]);
+	if( !fit->temp || !gamma_white_point(fit->temp,white_point) )
+		return RET_FUN_FAILED;
+	// Least squares brightness against the fitted white point
+	for( i=0; i<3; ++i ){
+		num += amp[i]*white_point[i];
+		den += white_point[i]*white_point[i];
+	}
+	fit->brightness = (float)(num/den);
+	fit->gamma.r = 1.0f/slope[0];
+	fit->gamma.g = 1.0f/slope[1];
+	fit->gamma.b = 1.0f/slope[2];
+	return RET_FUN_SUCCESS;
+}
+
+/* Estimates the temperature of a read back ramp */
+int gamma_ramp_read_temp(const uint16_t *r, const uint16_t *g,
+		const uint16_t *b, int size)
+{
+	gamma_fit_s fit;
+
+	if( size<=0 )
+		return RET_FUN_FAILED;
+	LOG(LOGVERBOSE,_("Gamma end points: (%d,%d)"),r[size-1],b[size-1]);
+	if( opt_get_fit() ){
+		if( gamma_fit_ramp(r,g,b,size,&fit) ){
+			LOG(LOGVERBOSE,_("Ramp fit: %dK, brightness %f, gamma %f:%f:%f"),
+					fit.temp,fit.brightness,
+					fit.gamma.r,fit.gamma.g,fit.gamma.b);
+			return fit.temp;
 		}
-		prev_ratio = curr_ratio;
+		LOG(LOGVERBOSE,_("Ramp fit failed, using end points"));
 	}
-	LOG(LOGERR,_("Unable to find color temperature"));
-	return RET_FUN_FAILED;
+	return gamma_find_temp((float)r[size-1]/(float)b[size-1]);
+}
+
+// Frees the inverse index
+static void gamma_free_index(void)
+	/*@globals inv_index@*/
+{
+	if( inv_index.ratio )
+		free(inv_index.ratio);
+	inv_index.ratio = NULL;
+	inv_index.table = NULL;
+	inv_index.size = 0;
+}
+
+/* Drops state derived from the white point table */
+void gamma_table_changed(void){
+	gamma_free_index();
+	gamma_cache_clear();
+	gamma_ladder_free_arena();
 }
 
 /* Looks up gamma method by name */
@@ -159,9 +899,12 @@ int gamma_load_methods(void){
 		methods[i].func_set_temp = NULL;
 		methods[i].func_get_temp = NULL;
 		methods[i].func_restore = NULL;
+		methods[i].func_get_fd = NULL;
+		methods[i].func_handle_events = NULL;
 		methods[i].name = NULL;
 	}
 	methods[GAMMA_METHOD_AUTO].name = "Auto";
+	(void)gamma_simd_init();
 #ifdef ENABLE_RANDR
 	if(randr_load_funcs(&methods[GAMMA_METHOD_RANDR])!=RET_FUN_SUCCESS)
 		return RET_FUN_FAILED;
@@ -223,8 +966,18 @@ int gamma_state_restore(void)
 /* Free the state associated with the appropriate adjustment method. */
 int gamma_state_free(void)
 {
-	if(gamma_free_ramps(&ramp)!=RET_FUN_SUCCESS)
-		return RET_FUN_FAILED;
+	gamma_free_curves();
+	gamma_free_index();
+	LOG(LOGINFO,_("Ramp cache: %lu hits, %lu misses, %lu evictions"),
+			cache_stats.hits,cache_stats.misses,cache_stats.evictions);
+	LOG(LOGINFO,_("Skipped %lu unchanged ramp writes"),commit_skipped);
+	if( paused.suppressed )
+		LOG(LOGINFO,_("Suppressed %lu ramp writes while paused"),
+				paused.suppressed);
+	if( ladder.hits )
+		LOG(LOGINFO,_("Prebuilt transition ramps used: %lu"),ladder.hits);
+	gamma_cache_clear();
+	gamma_ladder_free();
 	if( methods[active_method].func_end!=NULL ){
 		if( methods[active_method].func_end()==RET_FUN_SUCCESS ){
 			active_method = GAMMA_METHOD_NONE;
@@ -238,44 +991,26 @@ int gamma_state_free(void)
 /* Calculate color temperature for the specified solar elevation. */
 int gamma_calc_temp(double elevation, int temp_day, int temp_night)
 {
-	int temp = 0;
-	int i;
 	int size;
-	pair *map = opt_get_map(&size);
-	double prevelev=map[size-1].elev+360;
-	double prevtemp=map[size-1].temp;
-	double currelev;
-	double currtemp;
-	for( i = 0; i<size+1; ++i ){
-		if( i==size ){
-			currelev = map[0].elev-360.0;
-			currtemp = map[0].temp;
-		}else{
-			currelev = map[i].elev;
-			currtemp = map[i].temp;
-		}
-		if( (elevation<=prevelev)
-				&& (elevation>=currelev) ){
-			double ratio;
-			double temp_perc;
-			/* Found target elevation */
-			LOG(LOGVERBOSE,_("Found target elevation "
-					"between %f and %f"),prevelev,currelev);
-			ratio = (elevation-currelev)
-				/(prevelev-currelev);
-			temp_perc= ratio*(prevtemp-currtemp)
-				+currtemp;
-			temp = (int)((0.01*temp_perc)*(temp_day-temp_night)
-				+temp_night);
-			LOG(LOGVERBOSE,_("Target temp %d (ratio %f,%f)"),
-					temp,ratio,temp_perc);
-			return temp;
-		}
-		prevelev = currelev;
-		prevtemp = currtemp;
-	}
+	const float *table = opt_get_map_table(&size);
+	double pos;
+	double perc;
+	int i;
 
-	return temp;
+	if( elevation>180.0 )
+		elevation -= 360.0;
+	else if( elevation<-180.0 )
+		elevation += 360.0;
+	pos = (elevation-MAP_TABLE_MIN)/MAP_TABLE_STEP;
+	if( !(pos>0.0) )
+		pos = 0.0;
+	i = (int)pos;
+	if( i>=size-1 ){
+		i = size-2;
+		pos = (double)(size-1);
+	}
+	perc = table[i]+(pos-i)*(table[i+1]-table[i]);
+	return (int)((0.01*perc)*(temp_day-temp_night)+temp_night);
 }
 
 /* Calculates the current target temperature */
@@ -298,6 +1033,53 @@ int gamma_calc_curr_target_temp(float lat, float lon,
 	return temp;
 }
 
+// Target temperature at a time in mireds
+static double gamma_target_mireds(double date, float lat, float lon,
+		int temp_day, int temp_night)
+{
+	int temp = gamma_calc_temp(solar_elevation(date,lat,lon),
+			temp_day,temp_night);
+	return 1e6/MAX(temp,1);
+}
+
+/* Finds when the target temperature next changes noticeably */
+double gamma_calc_next_change(float lat, float lon, int temp_day,
+		int temp_night, double now, double mireds, double horizon)
+{
+	double start = gamma_target_mireds(now,lat,lon,temp_day,temp_night);
+	double lo = now;
+	double hi = now;
+	double mid;
+
+	// Coarse scan, the target changes far slower than the scan step
+	do{
+		lo = hi;
+		hi = MIN(hi+NEXT_CHANGE_SCAN,now+horizon);
+		if( hi<=lo )
+			return now+horizon;
+	}while( fabs(gamma_target_mireds(hi,lat,lon,temp_day,temp_night)-start)
+			<mireds );
+	// Then bisect down to the precision
+	while( hi-lo>NEXT_CHANGE_PRECISION ){
+		mid = 0.5*(lo+hi);
+		if( fabs(gamma_target_mireds(mid,lat,lon,temp_day,temp_night)-start)
+				<mireds )
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return hi;
+}
+
+// Writes to the backend and notes what the ramps show
+static int gamma_state_write(int temp, gamma_s gamma){
+	if( !methods[active_method].func_set_temp
+			|| !methods[active_method].func_set_temp(temp,gamma) )
+		return RET_FUN_FAILED;
+	paused.shown = temp;
+	return RET_FUN_SUCCESS;
+}
+
 /* Set temperature with the appropriate adjustment method. */
 int gamma_state_set_temperature(int temp, gamma_s gamma)
 {
@@ -305,15 +1087,90 @@ int gamma_state_set_temperature(int temp, gamma_s gamma)
 		LOG(LOGERR,_("Invalid temperature specified"));
 		return RET_FUN_FAILED;
 	}
-	if( methods[active_method].func_set_temp )
-		return methods[active_method].func_set_temp(temp,gamma);
-	return RET_FUN_FAILED;
+	// The last request is written again on resume, so a resume queued
+	// since the last write writes this one
+	paused.temp = temp;
+	paused.gamma = gamma;
+	paused.resumed = -1;
+	if( !gamma_state_handle_events() )
+		return RET_FUN_FAILED;
+	if( paused.resumed>=0 )
+		return paused.resumed;
+	if( paused.reasons ){
+		++paused.suppressed;
+		return RET_FUN_SUCCESS;
+	}
+	return gamma_state_write(temp,gamma);
+}
+
+/* Writes a temperature even while ramp writes are paused */
+int gamma_state_write_temperature(int temp, gamma_s gamma)
+{
+	if( (temp<MIN_TEMP) || (temp>MAX_TEMP) ){
+		LOG(LOGERR,_("Invalid temperature specified"));
+		return RET_FUN_FAILED;
+	}
+	paused.temp = temp;
+	paused.gamma = gamma;
+	// The ramps may have been reset while paused
+	if( paused.reasons )
+		gamma_force_refresh();
+	return gamma_state_write(temp,gamma);
+}
+
+/* Pauses or resumes ramp writes */
+void gamma_state_pause(int reason, int on){
+	int reasons = on ? (paused.reasons|reason) : (paused.reasons&~reason);
+
+	if( reasons==paused.reasons )
+		return;
+	LOG(LOGINFO,_("Ramp writes %s (%s), %lu suppressed so far"),
+			on ? _("paused") : _("resumed"),
+			(reason==GAMMA_PAUSE_BLANKED) ? _("display blanked")
+				: _("fullscreen window"),paused.suppressed);
+	paused.reasons = reasons;
+	if( reasons || (paused.temp==0) )
+		return;
+	// One write of the latest request even if nothing was requested while
+	// paused, blanking or the fullscreen window may have reset the ramps
+	gamma_force_refresh();
+	paused.resumed = gamma_state_write(paused.temp,paused.gamma);
+	if( !paused.resumed )
+		LOG(LOGERR,_("Temperature adjustment failed."));
+}
+
+/* Retrieves the reasons ramp writes are paused for */
+int gamma_state_paused(void){
+	return paused.reasons;
+}
+
+/* Retrieves the number of writes suppressed while paused */
+unsigned long gamma_pause_suppressed(void){
+	return paused.suppressed;
 }
 
 /* Retrieves temperature with the appropriate adjustment method. */
 int gamma_state_get_temperature(void){
+	// Requests made while paused were not written, the ramps show the last
+	// write
+	if( paused.reasons && (paused.shown!=0) )
+		return paused.shown;
 	if( methods[active_method].func_get_temp )
 		return methods[active_method].func_get_temp();
 	return RET_FUN_FAILED;
 }
 
+/* Retrieves the display connection file descriptor */
+int gamma_state_get_fd(void){
+	if( methods[active_method].func_get_fd )
+		return methods[active_method].func_get_fd();
+	return -1;
+}
+
+/* Handles pending display events */
+int gamma_state_handle_events(void){
+	if( methods[active_method].func_handle_events )
+		return methods[active_method].func_handle_events();
+	return RET_FUN_SUCCESS;
+}
+
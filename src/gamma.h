@@ -24,6 +24,13 @@
 #define DEFAULT_NIGHT_TEMP	3600
 /**\brief Default gamma values */
 #define DEFAULT_GAMMA		1.0
+/**\brief Default ramp cache size in KB */
+#define DEFAULT_CACHE_SIZE	512
+
+/**\brief Writes paused, the display is blanked (DPMS, screensaver) */
+#define GAMMA_PAUSE_BLANKED	0x1
+/**\brief Writes paused, a fullscreen window is focused */
+#define GAMMA_PAUSE_FULLSCREEN	0x2
 
 /**\brief gamma structure */
 typedef struct{
@@ -43,6 +50,13 @@ typedef struct{
 	double temp;
 } pair;
 
+/**\brief Elevation of the first compiled map entry */
+#define MAP_TABLE_MIN	-180.0
+/**\brief Elevation step of the compiled map in degrees */
+#define MAP_TABLE_STEP	0.1
+/**\brief Number of compiled map entries, covers -180 to 180 degrees */
+#define MAP_TABLE_SIZE	3601
+
 /**\brief Maps temperature to RGB */
 typedef struct{
 	/**\brief Temperature */
@@ -65,6 +79,45 @@ typedef /*@partial@*/ struct{
 	int size;
 } gamma_ramp_s;
 
+/**\brief Last ramp committed to an output
+ * \details Backends keep one per output and check it with
+ * gamma_commit_needed() before writing a ramp to the hardware.
+ */
+typedef struct{
+	/**\brief Hash of the committed ramp */
+	uint64_t hash;
+	/**\brief Hash of the ramp being written */
+	uint64_t pending;
+	/**\brief Refresh generation of the commit, 0 if nothing committed */
+	unsigned int gen;
+} gamma_commit_s;
+
+/**\brief Ramp cache statistics */
+typedef struct{
+	/**\brief Number of ramps served from the cache */
+	unsigned long hits;
+	/**\brief Number of ramps that had to be built */
+	unsigned long misses;
+	/**\brief Number of entries dropped to stay under the limit */
+	unsigned long evictions;
+	/**\brief Current number of entries */
+	int entries;
+	/**\brief Current memory used in bytes */
+	size_t bytes;
+	/**\brief Memory limit in bytes */
+	size_t limit;
+} gamma_cache_stats_s;
+
+/**\brief Ramp parameters recovered by gamma_fit_ramp() */
+typedef struct{
+	/**\brief Temperature */
+	int temp;
+	/**\brief Brightness */
+	float brightness;
+	/**\brief Gamma per channel */
+	gamma_s gamma;
+} gamma_fit_s;
+
 /**\brief Gamma method functions */
 typedef struct{
 	/**\brief Function to initialize method */
@@ -77,6 +130,10 @@ typedef struct{
 	/*@null@*/ int (*func_get_temp)(void);
 	/**\brief Function to restore the saved ramps */
 	/*@null@*/ int (*func_restore)(void);
+	/**\brief Function to get the display connection file descriptor */
+	/*@null@*/ int (*func_get_fd)(void);
+	/**\brief Function to handle pending display events */
+	/*@null@*/ int (*func_handle_events)(void);
 	/**\brief Method name. */
 	/*@observer@*/ char *name;
 } gamma_method_s;
@@ -91,20 +148,121 @@ typedef enum {
 	GAMMA_METHOD_MAX		/**< Tracks the highest value */
 } gamma_method_t;
 
-/**\brief Re-allocates ramps if size changed, otherwise return pointer to ramp */
-gamma_ramp_s gamma_get_ramps(int size)
+/**\brief Takes a ramp buffer of the given size from the pool
+ * \details Each output should hold its own buffer for its lifetime, so
+ * several outputs can be filled before any of them is committed.
+ * Buffers are only allocated if no idle buffer of that size exists.
+ */
+gamma_ramp_s gamma_pool_get(int size)
 	/*@modifies internalState@*/;
 
-/**\brief Updates gamma ramp structure */
-gamma_ramp_s gamma_ramp_fill(int size,int temp);
+/**\brief Returns a ramp buffer to the pool */
+void gamma_pool_put(gamma_ramp_s *ramp)
+	/*@modifies internalState@*/;
+
+/**\brief Frees all idle buffers in the pool */
+void gamma_pool_clear(void)
+	/*@modifies internalState@*/;
+
+/**\brief Fills a caller owned ramp for a temperature
+ * \details Ramps are served from an LRU cache keyed by temperature,
+ * brightness, gamma tweak and size.
+ * \param ramp ramp buffer from gamma_pool_get()
+ * \param temp temperature
+ */
+int gamma_ramp_fill(gamma_ramp_s *ramp,int temp);
+
+/**\brief Builds the ramps of every temperature of a transition up front
+ * \details The ramps of all sizes filled so far are built into one arena,
+ * gamma_ramp_fill() then copies them out instead of computing them.  A
+ * size filled for the first time rebuilds the arena, so do a fill before
+ * the first transition to keep the burst at the start.  Replaces any
+ * ladder built before.
+ * \param temps temperatures the transition will commit
+ * \param count number of temperatures
+ */
+int gamma_ladder_build(const int *temps, int count);
+
+/**\brief Frees the ramps built by gamma_ladder_build() */
+void gamma_ladder_free(void);
+
+/**\brief Derives a ramp from a larger master ramp
+ * \details Only done when the master size is a multiple of the ramp size,
+ * the samples then fall exactly on master entries and the result is
+ * identical to gamma_ramp_fill().
+ * \param master ramp filled at the largest size
+ * \param ramp ramp to fill
+ * \return RET_FUN_FAILED if the sizes do not allow exact resampling
+ */
+int gamma_ramp_resample(const gamma_ramp_s *master, gamma_ramp_s *ramp);
+
+/**\brief Checks whether a ramp has to be written to an output
+ * \details Returns 0 and counts a skipped write if the ramp is identical
+ * to the last one committed, call gamma_commit_done() once the write
+ * succeeded.
+ * \param commit commit record of the output
+ * \param ramp ramp about to be written
+ */
+int gamma_commit_needed(gamma_commit_s *commit, const gamma_ramp_s *ramp);
+
+/**\brief Records the ramp checked by gamma_commit_needed() as committed */
+void gamma_commit_done(gamma_commit_s *commit);
+
+/**\brief Forgets all committed ramps, so the next write always happens
+ * \details For when something other than us may have touched the ramps.
+ */
+void gamma_force_refresh(void);
+
+/**\brief Retrieves the number of writes skipped as redundant */
+unsigned long gamma_commit_skipped(void);
+
+/**\brief Sets the memory limit of the ramp cache, 0 disables caching */
+void gamma_cache_set_limit(size_t bytes);
+
+/**\brief Empties the ramp cache */
+void gamma_cache_clear(void);
+
+/**\brief Retrieves ramp cache statistics */
+void gamma_cache_get_stats(/*@out@*/ gamma_cache_stats_s *stats);
 
 /**\brief Retrieves method name by id */
 extern /*@observer@*/ char *gamma_get_method_name(gamma_method_t method)
 	/*@modifies internalState@*/;
 
-/**\brief Find the temperature based on red:blue ratio */
+/**\brief Find the temperature based on red:blue ratio
+ * \details Binary search of an index built from the white point table on
+ * first use.
+ */
 int gamma_find_temp(float ratio);
 
+/**\brief Fits temperature, brightness and gamma to a whole ramp
+ * \details Does a least squares fit of each channel in the log domain,
+ * the temperature then comes from the red/blue amplitude ratio so it is
+ * not thrown off by brightness or gamma tweaks.  For ramps filled by
+ * gamma_ramp_fill() it is within 2K of the temperature filled, up to 3K
+ * near MAX_TEMP where the ratio changes the least.
+ * \param r red ramp
+ * \param g green ramp
+ * \param b blue ramp
+ * \param size entries per channel
+ * \param fit recovered parameters
+ * \return RET_FUN_FAILED if a channel is too dark to fit
+ */
+int gamma_fit_ramp(const uint16_t *r, const uint16_t *g, const uint16_t *b,
+		int size, /*@out@*/ gamma_fit_s *fit);
+
+/**\brief Estimates the temperature of a ramp read back from hardware
+ * \details Uses gamma_fit_ramp() if enabled by opt_set_fit(), the red/blue
+ * end point ratio otherwise.
+ */
+int gamma_ramp_read_temp(const uint16_t *r, const uint16_t *g,
+		const uint16_t *b, int size);
+
+/**\brief Drops the ramp cache and temperature index
+ * \details Call when the white point table has been replaced.
+ */
+void gamma_table_changed(void);
+
 /**\brief Load methods available */
 int gamma_load_methods(void);
 
@@ -121,9 +279,26 @@ int gamma_state_restore(void);
 /**\brief Free the state associated with the appropriate adjustment method. */
 int gamma_state_free(void);
 
-/**\brief Calculate temperature based on elevation. */
+/**\brief Calculate temperature based on elevation.
+ * \details Interpolates the compiled map from opt_get_map_table().
+ */
 int gamma_calc_temp(double elevation, int temp_day, int temp_night);
 
+/**\brief Finds when the target temperature next changes noticeably
+ * \details Scans the solar elevation forward from now and bisects to the
+ * second.
+ * \param lat latitude
+ * \param lon longitude
+ * \param temp_day day temperature
+ * \param temp_night night temperature
+ * \param now current system time
+ * \param mireds smallest change of the target to look for, in mireds
+ * \param horizon how far to look ahead in seconds
+ * \return system time of the change, now+horizon if there is none
+ */
+double gamma_calc_next_change(float lat, float lon, int temp_day,
+		int temp_night, double now, double mireds, double horizon);
+
 /**\brief Calculates the target temperature for now */
 int gamma_calc_curr_target_temp(float lat, float lon,
 		int temp_day, int temp_night);
@@ -131,7 +306,44 @@ int gamma_calc_curr_target_temp(float lat, float lon,
 /**\brief Sets the temperature */
 int gamma_state_set_temperature(int temp, gamma_s gamma);
 
-/**\brief Retrieves current temperature */
+/**\brief Writes a temperature even while ramp writes are paused
+ * \details For the last write before exiting, the ramps must not be left
+ * at whatever was shown when the pause began.
+ */
+int gamma_state_write_temperature(int temp, gamma_s gamma);
+
+/**\brief Retrieves current temperature
+ * \details While ramp writes are paused this is the last temperature
+ * written, requests made since only reach the display on resume.
+ */
 int gamma_state_get_temperature(void);
 
+/**\brief Pauses or resumes ramp writes
+ * \details Called by backends on display events.  While any reason is in
+ * effect, gamma_state_set_temperature() only records the request.  Once
+ * all reasons are gone the last request is written, bypassing the check
+ * for unchanged ramps, even if it was made before the pause.
+ * \param reason GAMMA_PAUSE_BLANKED or GAMMA_PAUSE_FULLSCREEN
+ * \param on 1 to pause, 0 to resume
+ */
+void gamma_state_pause(int reason, int on);
+
+/**\brief Retrieves the GAMMA_PAUSE_* reasons in effect, 0 if writing */
+int gamma_state_paused(void);
+
+/**\brief Retrieves the number of writes suppressed while paused */
+unsigned long gamma_pause_suppressed(void);
+
+/**\brief Retrieves the file descriptor of the display connection
+ * \details Readable when display events are pending, see
+ * gamma_state_handle_events().
+ * \return -1 if the method has no such connection
+ */
+int gamma_state_get_fd(void);
+
+/**\brief Handles pending display events
+ * \return RET_FUN_FAILED if the display connection was lost
+ */
+int gamma_state_handle_events(void);
+
 #endif//__GAMMA_H__
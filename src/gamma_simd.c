@@ -0,0 +1,467 @@
+#include "common.h"
+#include "gamma_simd.h"
+
+/*@ignore@*/
+#if defined(ENABLE_SIMD) && defined(__GNUC__) \
+	&& (defined(__x86_64__) || defined(__i386__))
+# define GAMMA_SIMD_X86
+# define SIMD_TARGET(X) __attribute__((target(X)))
+# include <immintrin.h>
+#elif defined(ENABLE_SIMD) && defined(_MSC_VER) \
+	&& (defined(_M_X64) || defined(_M_IX86))
+# define GAMMA_SIMD_X86
+# define SIMD_TARGET(X)
+# include <intrin.h>
+# include <immintrin.h>
+#endif
+/*@end@*/
+
+/* Polynomial coefficients, log2(m) = t*(C1+t^2*(C3+...)), t=(m-1)/(m+1) */
+#define LOG2_C1 2.885390082f
+#define LOG2_C3 0.961796694f
+#define LOG2_C5 0.577078016f
+#define LOG2_C7 0.412198583f
+#define LOG2_C9 0.320598898f
+/* Taylor coefficients of 2^f = e^(f*ln2) */
+#define EXP2_C1 0.693147181f
+#define EXP2_C2 0.240226507f
+#define EXP2_C3 0.055504109f
+#define EXP2_C4 0.009618129f
+#define EXP2_C5 0.001333355f
+#define EXP2_C6 0.000154035f
+#define EXP2_C7 0.000015253f
+/* Exponent limits for exp2 */
+#define EXP2_MIN -126.0f
+#define EXP2_MAX  126.0f
+/* log2(e) */
+#define LOG2_E 1.442695041
+/* Entries per fit block, float lane sums are flushed to double after each */
+#define LOGSUM_BLOCK 256
+
+typedef void (*curve_fn)(float *curve, int start, int size, float exponent);
+typedef void (*scale_fn)(uint16_t *out, const float *curve,
+		int start, int size, float scale);
+typedef void (*logsum_fn)(const uint16_t *ramp, int start, int end,
+		int size, float min, gamma_simd_sums_s *sums);
+
+static const char *kernel_names[GAMMA_SIMD_MAX]={"Scalar","SSE2","AVX2"};
+
+// Scalar shaping pass, also used for leftover elements
+static void _curve_scalar(float *curve, int start, int size, float exponent){
+	int i;
+	if( exponent==1.0f ){
+		for( i=start; i<size; ++i )
+			curve[i] = (float)i/size;
+		return;
+	}
+	for( i=start; i<size; ++i )
+		curve[i] = (float)pow((float)i/size,exponent);
+}
+
+// Scalar conversion pass, also used for leftover elements
+static void _scale_scalar(uint16_t *out, const float *curve,
+		int start, int size, float scale)
+{
+	int i;
+	for( i=start; i<size; ++i ){
+		float v = curve[i]*scale;
+		if( v<0.0f )
+			v = 0.0f;
+		else if( v>(float)UINT16_MAX )
+			v = (float)UINT16_MAX;
+		out[i] = (uint16_t)v;
+	}
+}
+
+// Scalar fit sums, start must be at least 1
+static void _logsums_scalar(const uint16_t *ramp, int start, int end,
+		int size, float min, gamma_simd_sums_s *sums)
+{
+	int i;
+	for( i=start; i<end; ++i ){
+		double x,y;
+		if( (float)ramp[i]<min )
+			continue;
+		x = log((double)i/size)*LOG2_E;
+		y = log((double)ramp[i]+0.5)*LOG2_E;
+		sums->n += 1.0;
+		sums->sx += x;
+		sums->sy += y;
+		sums->sxx += x*x;
+		sums->sxy += x*y;
+	}
+}
+
+#ifdef GAMMA_SIMD_X86
+// SSE2 log2 for x in (0,inf)
+SIMD_TARGET("sse2")
+static __m128 _log2_sse2(__m128 x){
+	__m128i bits = _mm_castps_si128(x);
+	__m128i expo = _mm_sub_epi32(_mm_srli_epi32(bits,23),_mm_set1_epi32(127));
+	__m128 m = _mm_castsi128_ps(_mm_or_si128(
+			_mm_and_si128(bits,_mm_set1_epi32(0x007fffff)),
+			_mm_set1_epi32(0x3f800000)));
+	// Center mantissa around 1 to keep t small
+	__m128 big = _mm_cmpgt_ps(m,_mm_set1_ps(1.41421356f));
+	__m128 e = _mm_add_ps(_mm_cvtepi32_ps(expo),
+			_mm_and_ps(big,_mm_set1_ps(1.0f)));
+	__m128 t,t2,p;
+	m = _mm_or_ps(_mm_andnot_ps(big,m),
+			_mm_and_ps(big,_mm_mul_ps(m,_mm_set1_ps(0.5f))));
+	t = _mm_div_ps(_mm_sub_ps(m,_mm_set1_ps(1.0f)),
+			_mm_add_ps(m,_mm_set1_ps(1.0f)));
+	t2 = _mm_mul_ps(t,t);
+	p = _mm_add_ps(_mm_set1_ps(LOG2_C7),_mm_mul_ps(t2,_mm_set1_ps(LOG2_C9)));
+	p = _mm_add_ps(_mm_set1_ps(LOG2_C5),_mm_mul_ps(t2,p));
+	p = _mm_add_ps(_mm_set1_ps(LOG2_C3),_mm_mul_ps(t2,p));
+	p = _mm_add_ps(_mm_set1_ps(LOG2_C1),_mm_mul_ps(t2,p));
+	return _mm_add_ps(e,_mm_mul_ps(t,p));
+}
+
+// SSE2 exp2
+SIMD_TARGET("sse2")
+static __m128 _exp2_sse2(__m128 y){
+	__m128i n;
+	__m128 f,p;
+	y = _mm_min_ps(_mm_max_ps(y,_mm_set1_ps(EXP2_MIN)),
+			_mm_set1_ps(EXP2_MAX));
+	n = _mm_cvtps_epi32(y);
+	f = _mm_sub_ps(y,_mm_cvtepi32_ps(n));
+	p = _mm_add_ps(_mm_set1_ps(EXP2_C6),_mm_mul_ps(f,_mm_set1_ps(EXP2_C7)));
+	p = _mm_add_ps(_mm_set1_ps(EXP2_C5),_mm_mul_ps(f,p));
+	p = _mm_add_ps(_mm_set1_ps(EXP2_C4),_mm_mul_ps(f,p));
+	p = _mm_add_ps(_mm_set1_ps(EXP2_C3),_mm_mul_ps(f,p));
+	p = _mm_add_ps(_mm_set1_ps(EXP2_C2),_mm_mul_ps(f,p));
+	p = _mm_add_ps(_mm_set1_ps(EXP2_C1),_mm_mul_ps(f,p));
+	p = _mm_add_ps(_mm_set1_ps(1.0f),_mm_mul_ps(f,p));
+	return _mm_mul_ps(p,_mm_castsi128_ps(_mm_slli_epi32(
+				_mm_add_epi32(n,_mm_set1_epi32(127)),23)));
+}
+
+SIMD_TARGET("sse2")
+static void _curve_sse2(float *curve, int start, int size, float exponent){
+	int i;
+	__m128 vsize = _mm_set1_ps((float)size);
+	__m128 vexp = _mm_set1_ps(exponent);
+	__m128 step = _mm_set1_ps(4.0f);
+	__m128 idx = _mm_set_ps((float)(start+3),(float)(start+2),
+			(float)(start+1),(float)start);
+	for( i=start; i+4<=size; i+=4 ){
+		__m128 x = _mm_div_ps(idx,vsize);
+		if( exponent!=1.0f ){
+			__m128 zero = _mm_cmpeq_ps(x,_mm_setzero_ps());
+			x = _mm_andnot_ps(zero,_exp2_sse2(
+					_mm_mul_ps(vexp,_log2_sse2(x))));
+		}
+		_mm_storeu_ps(curve+i,x);
+		idx = _mm_add_ps(idx,step);
+	}
+	_curve_scalar(curve,i,size,exponent);
+}
+
+SIMD_TARGET("sse2")
+static void _scale_sse2(uint16_t *out, const float *curve,
+		int start, int size, float scale)
+{
+	int i;
+	__m128 vscale = _mm_set1_ps(scale);
+	__m128 vmax = _mm_set1_ps((float)UINT16_MAX);
+	__m128i bias = _mm_set1_epi32(32768);
+	__m128i flip = _mm_set1_epi16((short)0x8000);
+	for( i=start; i+8<=size; i+=8 ){
+		__m128 a = _mm_mul_ps(_mm_loadu_ps(curve+i),vscale);
+		__m128 b = _mm_mul_ps(_mm_loadu_ps(curve+i+4),vscale);
+		__m128i ia,ib;
+		a = _mm_min_ps(_mm_max_ps(a,_mm_setzero_ps()),vmax);
+		b = _mm_min_ps(_mm_max_ps(b,_mm_setzero_ps()),vmax);
+		// No unsigned pack in SSE2, bias into signed range and back
+		ia = _mm_sub_epi32(_mm_cvttps_epi32(a),bias);
+		ib = _mm_sub_epi32(_mm_cvttps_epi32(b),bias);
+		_mm_storeu_si128((__m128i*)(out+i),
+				_mm_xor_si128(_mm_packs_epi32(ia,ib),flip));
+	}
+	_scale_scalar(out,curve,i,size,scale);
+}
+
+// Adds SSE2 lane sums into the double sums
+SIMD_TARGET("sse2")
+static void _reduce_sse2(__m128 n, __m128 sx, __m128 sy, __m128 sxx,
+		__m128 sxy, gamma_simd_sums_s *sums)
+{
+	float lane[5][4];
+	int i;
+	_mm_storeu_ps(lane[0],n);
+	_mm_storeu_ps(lane[1],sx);
+	_mm_storeu_ps(lane[2],sy);
+	_mm_storeu_ps(lane[3],sxx);
+	_mm_storeu_ps(lane[4],sxy);
+	for( i=0; i<4; ++i ){
+		sums->n += lane[0][i];
+		sums->sx += lane[1][i];
+		sums->sy += lane[2][i];
+		sums->sxx += lane[3][i];
+		sums->sxy += lane[4][i];
+	}
+}
+
+SIMD_TARGET("sse2")
+static void _logsums_sse2(const uint16_t *ramp, int start, int end,
+		int size, float min, gamma_simd_sums_s *sums)
+{
+	int i;
+	__m128 vsize = _mm_set1_ps((float)size);
+	__m128 vmin = _mm_set1_ps(min);
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 half = _mm_set1_ps(0.5f);
+	__m128 step = _mm_set1_ps(4.0f);
+	__m128 idx = _mm_set_ps((float)(start+3),(float)(start+2),
+			(float)(start+1),(float)start);
+	__m128 n = _mm_setzero_ps();
+	__m128 sx = _mm_setzero_ps();
+	__m128 sy = _mm_setzero_ps();
+	__m128 sxx = _mm_setzero_ps();
+	__m128 sxy = _mm_setzero_ps();
+	for( i=start; i+4<=end; i+=4 ){
+		__m128i w = _mm_loadl_epi64((const __m128i*)(ramp+i));
+		__m128 v = _mm_cvtepi32_ps(_mm_unpacklo_epi16(w,_mm_setzero_si128()));
+		__m128 use = _mm_cmpge_ps(v,vmin);
+		__m128 x = _mm_and_ps(use,_log2_sse2(_mm_div_ps(idx,vsize)));
+		__m128 y = _mm_and_ps(use,_log2_sse2(_mm_add_ps(v,half)));
+		n = _mm_add_ps(n,_mm_and_ps(use,one));
+		sx = _mm_add_ps(sx,x);
+		sy = _mm_add_ps(sy,y);
+		sxx = _mm_add_ps(sxx,_mm_mul_ps(x,x));
+		sxy = _mm_add_ps(sxy,_mm_mul_ps(x,y));
+		idx = _mm_add_ps(idx,step);
+	}
+	_reduce_sse2(n,sx,sy,sxx,sxy,sums);
+	_logsums_scalar(ramp,i,end,size,min,sums);
+}
+
+// AVX2 log2 for x in (0,inf)
+SIMD_TARGET("avx2")
+static __m256 _log2_avx2(__m256 x){
+	__m256i bits = _mm256_castps_si256(x);
+	__m256i expo = _mm256_sub_epi32(_mm256_srli_epi32(bits,23),
+			_mm256_set1_epi32(127));
+	__m256 m = _mm256_castsi256_ps(_mm256_or_si256(
+			_mm256_and_si256(bits,_mm256_set1_epi32(0x007fffff)),
+			_mm256_set1_epi32(0x3f800000)));
+	__m256 big = _mm256_cmp_ps(m,_mm256_set1_ps(1.41421356f),_CMP_GT_OQ);
+	__m256 e = _mm256_add_ps(_mm256_cvtepi32_ps(expo),
+			_mm256_and_ps(big,_mm256_set1_ps(1.0f)));
+	__m256 t,t2,p;
+	m = _mm256_blendv_ps(m,_mm256_mul_ps(m,_mm256_set1_ps(0.5f)),big);
+	t = _mm256_div_ps(_mm256_sub_ps(m,_mm256_set1_ps(1.0f)),
+			_mm256_add_ps(m,_mm256_set1_ps(1.0f)));
+	t2 = _mm256_mul_ps(t,t);
+	p = _mm256_add_ps(_mm256_set1_ps(LOG2_C7),
+			_mm256_mul_ps(t2,_mm256_set1_ps(LOG2_C9)));
+	p = _mm256_add_ps(_mm256_set1_ps(LOG2_C5),_mm256_mul_ps(t2,p));
+	p = _mm256_add_ps(_mm256_set1_ps(LOG2_C3),_mm256_mul_ps(t2,p));
+	p = _mm256_add_ps(_mm256_set1_ps(LOG2_C1),_mm256_mul_ps(t2,p));
+	return _mm256_add_ps(e,_mm256_mul_ps(t,p));
+}
+
+// AVX2 exp2
+SIMD_TARGET("avx2")
+static __m256 _exp2_avx2(__m256 y){
+	__m256i n;
+	__m256 f,p;
+	y = _mm256_min_ps(_mm256_max_ps(y,_mm256_set1_ps(EXP2_MIN)),
+			_mm256_set1_ps(EXP2_MAX));
+	n = _mm256_cvtps_epi32(y);
+	f = _mm256_sub_ps(y,_mm256_cvtepi32_ps(n));
+	p = _mm256_add_ps(_mm256_set1_ps(EXP2_C6),
+			_mm256_mul_ps(f,_mm256_set1_ps(EXP2_C7)));
+	p = _mm256_add_ps(_mm256_set1_ps(EXP2_C5),_mm256_mul_ps(f,p));
+	p = _mm256_add_ps(_mm256_set1_ps(EXP2_C4),_mm256_mul_ps(f,p));
+	p = _mm256_add_ps(_mm256_set1_ps(EXP2_C3),_mm256_mul_ps(f,p));
+	p = _mm256_add_ps(_mm256_set1_ps(EXP2_C2),_mm256_mul_ps(f,p));
+	p = _mm256_add_ps(_mm256_set1_ps(EXP2_C1),_mm256_mul_ps(f,p));
+	p = _mm256_add_ps(_mm256_set1_ps(1.0f),_mm256_mul_ps(f,p));
+	return _mm256_mul_ps(p,_mm256_castsi256_ps(_mm256_slli_epi32(
+				_mm256_add_epi32(n,_mm256_set1_epi32(127)),23)));
+}
+
+SIMD_TARGET("avx2")
+static void _curve_avx2(float *curve, int start, int size, float exponent){
+	int i;
+	__m256 vsize = _mm256_set1_ps((float)size);
+	__m256 vexp = _mm256_set1_ps(exponent);
+	__m256 step = _mm256_set1_ps(8.0f);
+	__m256 idx = _mm256_set_ps((float)(start+7),(float)(start+6),
+			(float)(start+5),(float)(start+4),(float)(start+3),
+			(float)(start+2),(float)(start+1),(float)start);
+	for( i=start; i+8<=size; i+=8 ){
+		__m256 x = _mm256_div_ps(idx,vsize);
+		if( exponent!=1.0f ){
+			__m256 zero = _mm256_cmp_ps(x,_mm256_setzero_ps(),_CMP_EQ_OQ);
+			x = _mm256_andnot_ps(zero,_exp2_avx2(
+					_mm256_mul_ps(vexp,_log2_avx2(x))));
+		}
+		_mm256_storeu_ps(curve+i,x);
+		idx = _mm256_add_ps(idx,step);
+	}
+	_curve_scalar(curve,i,size,exponent);
+}
+
+SIMD_TARGET("avx2")
+static void _scale_avx2(uint16_t *out, const float *curve,
+		int start, int size, float scale)
+{
+	int i;
+	__m256 vscale = _mm256_set1_ps(scale);
+	__m256 vmax = _mm256_set1_ps((float)UINT16_MAX);
+	for( i=start; i+16<=size; i+=16 ){
+		__m256 a = _mm256_mul_ps(_mm256_loadu_ps(curve+i),vscale);
+		__m256 b = _mm256_mul_ps(_mm256_loadu_ps(curve+i+8),vscale);
+		__m256i packed;
+		a = _mm256_min_ps(_mm256_max_ps(a,_mm256_setzero_ps()),vmax);
+		b = _mm256_min_ps(_mm256_max_ps(b,_mm256_setzero_ps()),vmax);
+		// Pack works per 128 bit lane, fix the order afterwards
+		packed = _mm256_packus_epi32(_mm256_cvttps_epi32(a),
+				_mm256_cvttps_epi32(b));
+		_mm256_storeu_si256((__m256i*)(out+i),
+				_mm256_permute4x64_epi64(packed,0xD8));
+	}
+	_scale_scalar(out,curve,i,size,scale);
+}
+
+SIMD_TARGET("avx2")
+static void _logsums_avx2(const uint16_t *ramp, int start, int end,
+		int size, float min, gamma_simd_sums_s *sums)
+{
+	int i;
+	__m256 vsize = _mm256_set1_ps((float)size);
+	__m256 vmin = _mm256_set1_ps(min);
+	__m256 one = _mm256_set1_ps(1.0f);
+	__m256 half = _mm256_set1_ps(0.5f);
+	__m256 step = _mm256_set1_ps(8.0f);
+	__m256 idx = _mm256_set_ps((float)(start+7),(float)(start+6),
+			(float)(start+5),(float)(start+4),(float)(start+3),
+			(float)(start+2),(float)(start+1),(float)start);
+	__m256 n = _mm256_setzero_ps();
+	__m256 sx = _mm256_setzero_ps();
+	__m256 sy = _mm256_setzero_ps();
+	__m256 sxx = _mm256_setzero_ps();
+	__m256 sxy = _mm256_setzero_ps();
+	for( i=start; i+8<=end; i+=8 ){
+		__m256 v = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(
+				_mm_loadu_si128((const __m128i*)(ramp+i))));
+		__m256 use = _mm256_cmp_ps(v,vmin,_CMP_GE_OQ);
+		__m256 x = _mm256_and_ps(use,_log2_avx2(_mm256_div_ps(idx,vsize)));
+		__m256 y = _mm256_and_ps(use,_log2_avx2(_mm256_add_ps(v,half)));
+		n = _mm256_add_ps(n,_mm256_and_ps(use,one));
+		sx = _mm256_add_ps(sx,x);
+		sy = _mm256_add_ps(sy,y);
+		sxx = _mm256_add_ps(sxx,_mm256_mul_ps(x,x));
+		sxy = _mm256_add_ps(sxy,_mm256_mul_ps(x,y));
+		idx = _mm256_add_ps(idx,step);
+	}
+	// Fold the upper lanes and reuse the SSE2 reduction
+	_reduce_sse2(
+		_mm_add_ps(_mm256_castps256_ps128(n),_mm256_extractf128_ps(n,1)),
+		_mm_add_ps(_mm256_castps256_ps128(sx),_mm256_extractf128_ps(sx,1)),
+		_mm_add_ps(_mm256_castps256_ps128(sy),_mm256_extractf128_ps(sy,1)),
+		_mm_add_ps(_mm256_castps256_ps128(sxx),_mm256_extractf128_ps(sxx,1)),
+		_mm_add_ps(_mm256_castps256_ps128(sxy),_mm256_extractf128_ps(sxy,1)),
+		sums);
+	_logsums_scalar(ramp,i,end,size,min,sums);
+}
+
+// Checks CPU support for a kernel
+static int _cpu_supports(gamma_simd_t kernel){
+# if defined(__GNUC__)
+	__builtin_cpu_init();
+	if( kernel==GAMMA_SIMD_AVX2 )
+		return __builtin_cpu_supports("avx2");
+	if( kernel==GAMMA_SIMD_SSE2 )
+		return __builtin_cpu_supports("sse2");
+# else
+	int info[4];
+	__cpuid(info,0);
+	if( kernel==GAMMA_SIMD_SSE2 ){
+		__cpuid(info,1);
+		return (info[3]>>26)&1;
+	}
+	if( (kernel==GAMMA_SIMD_AVX2) && (info[0]>=7) ){
+		__cpuid(info,1);
+		// OS must save the AVX registers
+		if( !((info[2]>>27)&1) || ((_xgetbv(0)&6)!=6) )
+			return 0;
+		__cpuidex(info,7,0);
+		return (info[1]>>5)&1;
+	}
+# endif
+	return kernel==GAMMA_SIMD_SCALAR;
+}
+#else
+# define _cpu_supports(X) ((X)==GAMMA_SIMD_SCALAR)
+#endif//GAMMA_SIMD_X86
+
+static gamma_simd_t active_kernel = GAMMA_SIMD_SCALAR;
+static curve_fn curve_kernel = &_curve_scalar;
+static scale_fn scale_kernel = &_scale_scalar;
+static logsum_fn logsum_kernel = &_logsums_scalar;
+
+// Forces a kernel
+gamma_simd_t gamma_simd_select(gamma_simd_t kernel){
+	if( (kernel>=GAMMA_SIMD_MAX) || !_cpu_supports(kernel) )
+		kernel = GAMMA_SIMD_SCALAR;
+	active_kernel = kernel;
+	switch( kernel ){
+#ifdef GAMMA_SIMD_X86
+	case GAMMA_SIMD_AVX2:
+		curve_kernel = &_curve_avx2;
+		scale_kernel = &_scale_avx2;
+		logsum_kernel = &_logsums_avx2;
+		break;
+	case GAMMA_SIMD_SSE2:
+		curve_kernel = &_curve_sse2;
+		scale_kernel = &_scale_sse2;
+		logsum_kernel = &_logsums_sse2;
+		break;
+#endif//GAMMA_SIMD_X86
+	default:
+		curve_kernel = &_curve_scalar;
+		scale_kernel = &_scale_scalar;
+		logsum_kernel = &_logsums_scalar;
+		break;
+	}
+	return active_kernel;
+}
+
+// Picks best kernel for this CPU
+gamma_simd_t gamma_simd_init(void){
+	gamma_simd_t kernel = GAMMA_SIMD_AVX2;
+	while( (kernel>GAMMA_SIMD_SCALAR) && !_cpu_supports(kernel) )
+		kernel = (gamma_simd_t)(kernel-1);
+	(void)gamma_simd_select(kernel);
+	LOG(LOGINFO,_("Using %s ramp kernel"),gamma_simd_name(active_kernel));
+	return active_kernel;
+}
+
+const char *gamma_simd_name(gamma_simd_t kernel){
+	if( kernel>=GAMMA_SIMD_MAX )
+		return "None";
+	return kernel_names[kernel];
+}
+
+void gamma_simd_curve(float *curve, int size, float exponent){
+	curve_kernel(curve,0,size,exponent);
+}
+
+void gamma_simd_scale(uint16_t *out, const float *curve,
+		int size, float scale){
+	scale_kernel(out,curve,0,size,scale);
+}
+
+void gamma_simd_logsums(const uint16_t *ramp, int size, float min,
+		gamma_simd_sums_s *sums){
+	int i;
+	memset(sums,0,sizeof(*sums));
+	// Entry 0 has x=-inf and is never used
+	for( i=1; i<size; i+=LOGSUM_BLOCK )
+		logsum_kernel(ramp,i,MIN(i+LOGSUM_BLOCK,size),size,min,sums);
+}
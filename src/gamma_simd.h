@@ -0,0 +1,81 @@
+/**\file		gamma_simd.h
+ * \brief		Vectorized gamma ramp kernels.
+ * \details
+ * Ramp generation is split into two passes, a shaping pass that evaluates
+ * (i/size)^exponent into a float buffer and a conversion pass that scales
+ * the curve and truncates it to 16 bit ramp values.  Both passes have a
+ * scalar, an SSE2 and an AVX2 implementation; the fastest one supported by
+ * the running CPU is picked by gamma_simd_init().  The vector paths use
+ * polynomial log2/exp2 approximations, their output is within one LSB of
+ * the scalar libm result.
+ */
+
+#ifndef __GAMMA_SIMD_H__
+#define __GAMMA_SIMD_H__
+
+/**\brief Ramp kernel implementations */
+typedef enum {
+	GAMMA_SIMD_SCALAR,		/**< Plain C, uses libm pow() */
+	GAMMA_SIMD_SSE2,		/**< 4 wide SSE2 */
+	GAMMA_SIMD_AVX2,		/**< 8 wide AVX2 */
+	GAMMA_SIMD_MAX			/**< Tracks the highest value */
+} gamma_simd_t;
+
+/**\brief Sums for a least squares line fit of y=log2(ramp[i]) against
+ * x=log2(i/size) */
+typedef struct{
+	/**\brief Number of samples */
+	double n;
+	/**\brief Sum of x */
+	double sx;
+	/**\brief Sum of y */
+	double sy;
+	/**\brief Sum of x*x */
+	double sxx;
+	/**\brief Sum of x*y */
+	double sxy;
+} gamma_simd_sums_s;
+
+/**\brief Picks the best kernel supported by the CPU
+ * \return the selected kernel
+ */
+gamma_simd_t gamma_simd_init(void);
+
+/**\brief Forces a kernel, falls back to scalar if not supported
+ * \param kernel kernel to use
+ * \return the kernel actually selected
+ */
+gamma_simd_t gamma_simd_select(gamma_simd_t kernel);
+
+/**\brief Retrieves name of a kernel */
+/*@observer@*/ const char *gamma_simd_name(gamma_simd_t kernel);
+
+/**\brief Fills curve[i] with (i/size)^exponent for i in [0,size)
+ * \param curve output buffer of at least size floats
+ * \param size number of entries
+ * \param exponent exponent to apply (1/gamma)
+ */
+void gamma_simd_curve(/*@out@*/ float *curve, int size, float exponent);
+
+/**\brief Converts a shaped curve into a 16 bit ramp
+ * \details out[i] = (uint16_t)(curve[i]*scale), clamped to [0,UINT16_MAX]
+ * \param out output ramp of at least size entries
+ * \param curve input curve
+ * \param size number of entries
+ * \param scale multiplier (brightness*white point*UINT16_MAX)
+ */
+void gamma_simd_scale(/*@out@*/ uint16_t *out, const float *curve,
+		int size, float scale);
+
+/**\brief Accumulates log domain fit sums over a 16 bit ramp
+ * \details Entries below min are skipped since truncation dominates them,
+ * y is taken at ramp[i]+0.5 to undo the average truncation error.
+ * \param ramp input ramp
+ * \param size number of entries
+ * \param min smallest ramp value to use
+ * \param sums output sums
+ */
+void gamma_simd_logsums(const uint16_t *ramp, int size, float min,
+		/*@out@*/ gamma_simd_sums_s *sums);
+
+#endif//__GAMMA_SIMD_H__
@@ -1,198 +0,0 @@
-#ifndef __GAMMA_VALS_H__
-#define __GAMMA_VALS_H__
-
-/* Source f.lux */
-#define USE_FLUX_VALS
-#ifdef USE_FLUX_VALS
-static temp_gamma blackbody_color[] ={
-	{1000 ,{1.0000f, 0.5470f, 0.2132f}},
-	{1100 ,{1.0000f, 0.5582f, 0.2258f}},
-	{1200 ,{1.0000f, 0.5693f, 0.2385f}},
-	{1300 ,{1.0000f, 0.5802f, 0.2515f}},
-	{1400 ,{1.0000f, 0.5910f, 0.2646f}},
-	{1500 ,{1.0000f, 0.6017f, 0.2779f}},
-	{1600 ,{1.0000f, 0.6122f, 0.2913f}},
-	{1700 ,{1.0000f, 0.6227f, 0.3049f}},
-	{1800 ,{1.0000f, 0.6330f, 0.3186f}},
-	{1900 ,{1.0000f, 0.6433f, 0.3325f}},
-	{2000 ,{1.0000f, 0.6534f, 0.3464f}},
-	{2100 ,{1.0000f, 0.6634f, 0.3605f}},
-	{2200 ,{1.0000f, 0.6732f, 0.3747f}},
-	{2300 ,{1.0000f, 0.6829f, 0.3890f}},
-	{2400 ,{1.0000f, 0.6926f, 0.4034f}},
-	{2500 ,{1.0000f, 0.7021f, 0.4178f}},
-	{2600 ,{1.0000f, 0.7115f, 0.4323f}},
-	{2700 ,{1.0000f, 0.7208f, 0.4469f}},
-	{2800 ,{1.0000f, 0.7299f, 0.4616f}},
-	{2900 ,{1.0000f, 0.7390f, 0.4763f}},
-	{3000 ,{1.0000f, 0.7479f, 0.4910f}},
-	{3100 ,{1.0000f, 0.7568f, 0.5058f}},
-	{3200 ,{1.0000f, 0.7655f, 0.5206f}},
-	{3300 ,{1.0000f, 0.7741f, 0.5354f}},
-	{3400 ,{1.0000f, 0.7826f, 0.5503f}},
-	{3500 ,{1.0000f, 0.7910f, 0.5652f}},
-	{3600 ,{1.0000f, 0.7993f, 0.5801f}},
-	{3700 ,{1.0000f, 0.8075f, 0.5950f}},
-	{3800 ,{1.0000f, 0.8156f, 0.6099f}},
-	{3900 ,{1.0000f, 0.8237f, 0.6247f}},
-	{4000 ,{1.0000f, 0.8315f, 0.6396f}},
-	{4100 ,{1.0000f, 0.8393f, 0.6546f}},
-	{4200 ,{1.0000f, 0.8470f, 0.6694f}},
-	{4300 ,{1.0000f, 0.8546f, 0.6843f}},
-	{4400 ,{1.0000f, 0.8622f, 0.6991f}},
-	{4500 ,{1.0000f, 0.8696f, 0.7138f}},
-	{4600 ,{1.0000f, 0.8769f, 0.7286f}},
-	{4700 ,{1.0000f, 0.8841f, 0.7433f}},
-	{4800 ,{1.0000f, 0.8913f, 0.7581f}},
-	{4900 ,{1.0000f, 0.8984f, 0.7728f}},
-	{5000 ,{1.0000f, 0.9053f, 0.7874f}},
-	{5100 ,{1.0000f, 0.9122f, 0.8019f}},
-	{5200 ,{1.0000f, 0.9190f, 0.8164f}},
-	{5300 ,{1.0000f, 0.9258f, 0.8309f}},
-	{5400 ,{1.0000f, 0.9323f, 0.8454f}},
-	{5500 ,{1.0000f, 0.9388f, 0.8597f}},
-	{5600 ,{1.0000f, 0.9453f, 0.8740f}},
-	{5700 ,{1.0000f, 0.9517f, 0.8882f}},
-	{5800 ,{1.0000f, 0.9580f, 0.9024f}},
-	{5900 ,{1.0000f, 0.9642f, 0.9165f}},
-	{6000 ,{1.0000f, 0.9704f, 0.9306f}},
-	{6100 ,{1.0000f, 0.9764f, 0.9446f}},
-	{6200 ,{1.0000f, 0.9824f, 0.9586f}},
-	{6300 ,{1.0000f, 0.9884f, 0.9724f}},
-	{6400 ,{1.0000f, 0.9942f, 0.9862f}},
-	{6500 ,{1.0000f, 1.0000f, 1.0000f}},
-	{6600 ,{0.9867f, 0.9923f, 1.0000f}},
-	{6700 ,{0.9736f, 0.9847f, 1.0000f}},
-	{6800 ,{0.9610f, 0.9773f, 1.0000f}},
-	{6900 ,{0.9488f, 0.9701f, 1.0000f}},
-	{7000 ,{0.9369f, 0.9630f, 1.0000f}},
-	{7100 ,{0.9255f, 0.9561f, 1.0000f}},
-	{7200 ,{0.9142f, 0.9493f, 1.0000f}},
-	{7300 ,{0.9034f, 0.9428f, 1.0000f}},
-	{7400 ,{0.8928f, 0.9365f, 1.0000f}},
-	{7500 ,{0.8826f, 0.9303f, 1.0000f}},
-	{7600 ,{0.8727f, 0.9242f, 1.0000f}},
-	{7700 ,{0.8629f, 0.9182f, 1.0000f}},
-	{7800 ,{0.8537f, 0.9125f, 1.0000f}},
-	{7900 ,{0.8445f, 0.9068f, 1.0000f}},
-	{8000 ,{0.8357f, 0.9013f, 1.0000f}},
-	{8100 ,{0.8271f, 0.8960f, 1.0000f}},
-	{8200 ,{0.8186f, 0.8907f, 1.0000f}},
-	{8300 ,{0.8105f, 0.8856f, 1.0000f}},
-	{8400 ,{0.8025f, 0.8805f, 1.0000f}},
-	{8500 ,{0.7947f, 0.8757f, 1.0000f}},
-	{8600 ,{0.7871f, 0.8708f, 1.0000f}},
-	{8700 ,{0.7798f, 0.8661f, 1.0000f}},
-	{8800 ,{0.7726f, 0.8615f, 1.0000f}},
-	{8900 ,{0.7656f, 0.8570f, 1.0000f}},
-	{9000 ,{0.7588f, 0.8526f, 1.0000f}},
-	{9100 ,{0.7521f, 0.8483f, 1.0000f}},
-	{9200 ,{0.7456f, 0.8441f, 1.0000f}},
-	{9300 ,{0.7393f, 0.8400f, 1.0000f}},
-	{9400 ,{0.7331f, 0.8359f, 1.0000f}},
-	{9500 ,{0.7271f, 0.8320f, 1.0000f}},
-	{9600 ,{0.7212f, 0.8281f, 1.0000f}},
-	{9700 ,{0.7155f, 0.8243f, 1.0000f}},
-	{9800 ,{0.7098f, 0.8206f, 1.0000f}},
-	{9900 ,{0.7043f, 0.8169f, 1.0000f}},
-	{10000,{0.6989f, 0.8133f, 1.0000f}}
-};
-#else
-/* Source: http://www.vendian.org/mncharity/dir3/blackbody/
-   Rescaled to make exactly 6500K equal to full intensity in all channels. */
-static temp_gamma blackbody_color[] = {
-	{1000 ,{1.0000f, 0.0425f, 0.0000f}},
-	{1100 ,{1.0000f, 0.0668f, 0.0000f}},
-	{1200 ,{1.0000f, 0.0911f, 0.0000f}},
-	{1300 ,{1.0000f, 0.1149f, 0.0000f}},
-	{1400 ,{1.0000f, 0.1380f, 0.0000f}},
-	{1500 ,{1.0000f, 0.1604f, 0.0000f}},
-	{1600 ,{1.0000f, 0.1819f, 0.0000f}},
-	{1700 ,{1.0000f, 0.2024f, 0.0000f}},
-	{1800 ,{1.0000f, 0.2220f, 0.0000f}},
-	{1900 ,{1.0000f, 0.2406f, 0.0000f}},
-	{2000 ,{1.0000f, 0.2630f, 0.0062f}},
-	{2100 ,{1.0000f, 0.2868f, 0.0155f}},
-	{2200 ,{1.0000f, 0.3102f, 0.0261f}},
-	{2300 ,{1.0000f, 0.3334f, 0.0379f}},
-	{2400 ,{1.0000f, 0.3562f, 0.0508f}},
-	{2500 ,{1.0000f, 0.3787f, 0.0650f}},
-	{2600 ,{1.0000f, 0.4008f, 0.0802f}},
-	{2700 ,{1.0000f, 0.4227f, 0.0964f}},
-	{2800 ,{1.0000f, 0.4442f, 0.1136f}},
-	{2900 ,{1.0000f, 0.4652f, 0.1316f}},
-	{3000 ,{1.0000f, 0.4859f, 0.1505f}},
-	{3100 ,{1.0000f, 0.5062f, 0.1702f}},
-	{3200 ,{1.0000f, 0.5262f, 0.1907f}},
-	{3300 ,{1.0000f, 0.5458f, 0.2118f}},
-	{3400 ,{1.0000f, 0.5650f, 0.2335f}},
-	{3500 ,{1.0000f, 0.5839f, 0.2558f}},
-	{3600 ,{1.0000f, 0.6023f, 0.2786f}},
-	{3700 ,{1.0000f, 0.6204f, 0.3018f}},
-	{3800 ,{1.0000f, 0.6382f, 0.3255f}},
-	{3900 ,{1.0000f, 0.6557f, 0.3495f}},
-	{4000 ,{1.0000f, 0.6727f, 0.3739f}},
-	{4100 ,{1.0000f, 0.6894f, 0.3986f}},
-	{4200 ,{1.0000f, 0.7058f, 0.4234f}},
-	{4300 ,{1.0000f, 0.7218f, 0.4485f}},
-	{4400 ,{1.0000f, 0.7375f, 0.4738f}},
-	{4500 ,{1.0000f, 0.7529f, 0.4992f}},
-	{4600 ,{1.0000f, 0.7679f, 0.5247f}},
-	{4700 ,{1.0000f, 0.7826f, 0.5503f}}, /* 4700K ~= 3400K in f.lux*/
-	{4800 ,{1.0000f, 0.7970f, 0.5760f}},
-	{4900 ,{1.0000f, 0.8111f, 0.6016f}},
-	{5000 ,{1.0000f, 0.8250f, 0.6272f}},
-	{5100 ,{1.0000f, 0.8384f, 0.6529f}},
-	{5200 ,{1.0000f, 0.8517f, 0.6785f}},
-	{5300 ,{1.0000f, 0.8647f, 0.7040f}},
-	{5400 ,{1.0000f, 0.8773f, 0.7294f}},
-	{5500 ,{1.0000f, 0.8897f, 0.7548f}},
-	{5600 ,{1.0000f, 0.9019f, 0.7801f}},
-	{5700 ,{1.0000f, 0.9137f, 0.8051f}},
-	{5800 ,{1.0000f, 0.9254f, 0.8301f}},
-	{5900 ,{1.0000f, 0.9367f, 0.8550f}},
-	{6000 ,{1.0000f, 0.9478f, 0.8795f}},
-	{6100 ,{1.0000f, 0.9587f, 0.9040f}},
-	{6200 ,{1.0000f, 0.9694f, 0.9283f}},
-	{6300 ,{1.0000f, 0.9798f, 0.9524f}},
-	{6400 ,{1.0000f, 0.9900f, 0.9763f}},
-	{6500 ,{1.0000f, 1.0000f, 1.0000f}},
-	{6600 ,{0.9771f, 0.9867f, 1.0000f}},
-	{6700 ,{0.9554f, 0.9740f, 1.0000f}},
-	{6800 ,{0.9349f, 0.9618f, 1.0000f}},
-	{6900 ,{0.9154f, 0.9500f, 1.0000f}},
-	{7000 ,{0.8968f, 0.9389f, 1.0000f}},
-	{7100 ,{0.8792f, 0.9282f, 1.0000f}},
-	{7200 ,{0.8624f, 0.9179f, 1.0000f}},
-	{7300 ,{0.8465f, 0.9080f, 1.0000f}},
-	{7400 ,{0.8313f, 0.8986f, 1.0000f}},
-	{7500 ,{0.8167f, 0.8895f, 1.0000f}},
-	{7600 ,{0.8029f, 0.8808f, 1.0000f}},
-	{7700 ,{0.7896f, 0.8724f, 1.0000f}},
-	{7800 ,{0.7769f, 0.8643f, 1.0000f}},
-	{7900 ,{0.7648f, 0.8565f, 1.0000f}},
-	{8000 ,{0.7532f, 0.8490f, 1.0000f}},
-	{8100 ,{0.7420f, 0.8418f, 1.0000f}},
-	{8200 ,{0.7314f, 0.8348f, 1.0000f}},
-	{8300 ,{0.7212f, 0.8281f, 1.0000f}},
-	{8400 ,{0.7113f, 0.8216f, 1.0000f}},
-	{8500 ,{0.7018f, 0.8153f, 1.0000f}},
-	{8600 ,{0.6927f, 0.8092f, 1.0000f}},
-	{8700 ,{0.6839f, 0.8032f, 1.0000f}},
-	{8800 ,{0.6755f, 0.7975f, 1.0000f}},
-	{8900 ,{0.6674f, 0.7921f, 1.0000f}},
-	{9000 ,{0.6595f, 0.7867f, 1.0000f}},
-	{9100 ,{0.6520f, 0.7816f, 1.0000f}},
-	{9200 ,{0.6447f, 0.7765f, 1.0000f}},
-	{9300 ,{0.6376f, 0.7717f, 1.0000f}},
-	{9400 ,{0.6308f, 0.7670f, 1.0000f}},
-	{9500 ,{0.6242f, 0.7623f, 1.0000f}},
-	{9600 ,{0.6179f, 0.7579f, 1.0000f}},
-	{9700 ,{0.6117f, 0.7536f, 1.0000f}},
-	{9800 ,{0.6058f, 0.7493f, 1.0000f}},
-	{9900 ,{0.6000f, 0.7453f, 1.0000f}},
-	{10000,{0.5944f, 0.7414f, 1.0000f}}
-};
-#endif//USE_FLUX_VALS
-
-#endif//__GAMMA_VALS_H__
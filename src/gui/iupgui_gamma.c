@@ -1,64 +1,78 @@
 #include "common.h"
 #include "gamma.h"
 #include "options.h"
+#include "transition.h"
+#include "systemtime.h"
 #include "gui/iupgui.h"
 #include "gui/iupgui_main.h"
 #include "gui/iupgui_gamma.h"
 
 /*@null@*/ static Ihandle *timer_gamma_check=NULL;
 /*@null@*/ static Ihandle *timer_gamma_transition=NULL;
+/*@null@*/ static Ihandle *timer_clock_watch=NULL;
 
-static int curr_temp=1000;
-static int target_temp=1000;
+static transition_s trans;
+static systemtime_watch_s watch;
+static double watch_last;
 static int timers_disabled = 0;
 
-// Changes temperature
-static int _gamma_transition(/*@unused@*/ Ihandle *ih){
-	int transpeed = opt_get_trans_speed();
-	if( curr_temp > target_temp ){
-		curr_temp -= transpeed/10;
-		if( curr_temp < target_temp ){
-			(void)guigamma_set_temp(target_temp);
-			IupSetAttribute(timer_gamma_transition,"RUN","NO");
-			IupSetAttribute(timer_gamma_check,"RUN","YES");
-			return IUP_DEFAULT;
-		}
-	}else{
-		curr_temp += transpeed/10;
-		if( curr_temp > target_temp ){
-			(void)guigamma_set_temp(target_temp);
-			IupSetAttribute(timer_gamma_transition,"RUN","NO");
+// Arms the transition timer for the next tick
+static void _gamma_schedule(void){
+	double now;
+	double wait;
+	IupSetAttribute(timer_gamma_transition,"RUN","NO");
+	if( !transition_active(&trans) || !transition_now(&now) ){
+		if( !timers_disabled )
 			IupSetAttribute(timer_gamma_check,"RUN","YES");
-			return IUP_DEFAULT;
-		}
+		return;
 	}
+	wait = transition_next_deadline(&trans)-now;
+	// IUP timers take whole milliseconds and need at least 1
+	IupSetfAttribute(timer_gamma_transition,"TIME","%d",
+			MAX(1,(int)(wait*1000.0+0.5)));
+	IupSetAttribute(timer_gamma_transition,"RUN","YES");
+}
 
-	LOG(LOGVERBOSE,_("Transition color: %dK"),curr_temp);
-	if( !gamma_state_set_temperature(
-				curr_temp,opt_get_gamma()) ){
+// Changes temperature
+static int _gamma_transition(/*@unused@*/ Ihandle *ih){
+	double now;
+	if( transition_now(&now) && !transition_tick(&trans,now) )
 		LOG(LOGERR,_("Temperature adjustment failed (Target %d."),
-			curr_temp);
-		//IupSetAttribute(timer_gamma_transition,"RUN","NO");
-		//return IUP_DEFAULT;
-	}
+			trans.target);
+	_gamma_schedule();
 	guimain_update_info();
 	return IUP_DEFAULT;
 }
 
 // Returns current temperature as known by GUI
 int guigamma_get_temp(void){
-	return curr_temp;
+	return trans.curr;
 }
 
 // Sets the current temperature in GUI
 int guigamma_set_temp(int temp){
 	(void)gamma_state_set_temperature(temp,opt_get_gamma());
-	curr_temp = temp;
+	transition_init(&trans,temp);
+	return RET_FUN_SUCCESS;
+}
+
+// Moves towards a temperature, retargeting any transition in progress
+int guigamma_set_target(int temp){
+	double now;
+
+	if( temp==(transition_active(&trans) ? trans.target : trans.curr) )
+		return RET_FUN_SUCCESS;
+	if( !transition_now(&now) )
+		return guigamma_set_temp(temp);
+	IupSetAttribute(timer_gamma_check,"RUN","NO");
+	transition_set_target(&trans,temp,opt_get_trans_speed(),now);
+	_gamma_schedule();
 	return RET_FUN_SUCCESS;
 }
 
 // Check if temperature needs to be corrected
 int guigamma_check(/*@unused@*/ Ihandle *ih){
+	int target_temp;
 
 	if( timers_disabled )
 		return IUP_DEFAULT;
@@ -67,16 +81,37 @@ int guigamma_check(/*@unused@*/ Ihandle *ih){
 			opt_get_lat(),opt_get_lon(),
 			opt_get_temp_day(),opt_get_temp_night());
 	LOG(LOGINFO,_("Gamma check, current: %d, target: %d"),
-			curr_temp,target_temp);
-	if( fabs((double)(curr_temp - target_temp)) >= 1.0 ){
-		// Disable current timer
-		IupSetAttribute(timer_gamma_check,"RUN","NO");
-		IupSetAttribute(timer_gamma_transition,"RUN","YES");
-	}
+			trans.curr,target_temp);
+	(void)guigamma_set_target(target_temp);
 	guimain_update_info();
 	return IUP_DEFAULT;
 }
 
+// Checks for clock jumps, the 5 minute check would come too late
+static int _gamma_watch(/*@unused@*/ Ihandle *ih){
+	double now;
+	double jump;
+	int jumped = systemtime_watch_check(&watch,&jump);
+
+	// The GUI does not watch the display connection, pick up blanking
+	// changes here
+	(void)gamma_state_handle_events();
+	// A late timer means a suspend the monotonic clock counted
+	if( transition_now(&now) ){
+		if( now-watch_last>SYSTEMTIME_WATCH_PERIOD+SYSTEMTIME_JUMP ){
+			jump = now-watch_last-SYSTEMTIME_WATCH_PERIOD;
+			jumped = 1;
+		}
+		watch_last = now;
+	}
+	if( !jumped || timers_disabled )
+		return IUP_DEFAULT;
+	LOG(LOGINFO,_("System time jumped by %.0fs"),jump);
+	// Ramps are often reset on resume
+	gamma_force_refresh();
+	return guigamma_check(timer_gamma_check);
+}
+
 // Disables gamma timers and checking
 void guigamma_disable(void){
 	(void)guigamma_set_temp(DEFAULT_DAY_TEMP);
@@ -88,6 +123,7 @@ void guigamma_disable(void){
 
 // Enables gamma timers
 void guigamma_enable(void){
+	gamma_force_refresh();
 	IupSetAttribute(timer_gamma_check,"RUN","YES");
 	timers_disabled = 0;
 }
@@ -100,14 +136,24 @@ void guigamma_init_timers(void){
 	(void)IupSetCallback(timer_gamma_check,"ACTION_CB",(Icallback)guigamma_check);
 	IupSetAttribute(timer_gamma_check,"RUN","YES");
 
-	// Transition step size is 100 ms
+	// Rearmed for every tick by _gamma_schedule
 	timer_gamma_transition = IupTimer();
-	IupSetfAttribute(timer_gamma_transition,"TIME","%d",100);
+	IupSetfAttribute(timer_gamma_transition,"TIME","%d",
+			(int)(TRANSITION_STEP*1000));
 	(void)IupSetCallback(timer_gamma_transition,"ACTION_CB",(Icallback)_gamma_transition);
 
+	// Resync at once after a suspend or a clock change
+	(void)systemtime_watch_init(&watch);
+	if( !transition_now(&watch_last) )
+		watch_last = 0.0;
+	timer_clock_watch = IupTimer();
+	IupSetfAttribute(timer_clock_watch,"TIME","%d",
+			1000*SYSTEMTIME_WATCH_PERIOD);
+	(void)IupSetCallback(timer_clock_watch,"ACTION_CB",(Icallback)_gamma_watch);
+	IupSetAttribute(timer_clock_watch,"RUN","YES");
+
 	// Make sure gamma is synced up
-	curr_temp = gamma_state_get_temperature();
-	(void)gamma_state_set_temperature(curr_temp,opt_get_gamma());
+	(void)guigamma_set_temp(gamma_state_get_temperature());
 	(void)guigamma_check(timer_gamma_check);
 }
 
@@ -119,4 +165,7 @@ void guigamma_end_timers(void){
 	if( timer_gamma_transition )
 		IupDestroy(timer_gamma_transition);
 
+	if( timer_clock_watch )
+		IupDestroy(timer_clock_watch);
+
 }
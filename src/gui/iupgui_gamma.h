@@ -13,6 +13,10 @@ int guigamma_get_temp(void);
 /**\brief Sets the current temperature in GUI mode */
 int guigamma_set_temp(int temp);
 
+/**\brief Moves towards a temperature at the transition speed, a
+ * transition in progress continues from where it is */
+int guigamma_set_target(int temp);
+
 /**\brief Disables gamma timers */
 void guigamma_disable(void);
 
@@ -151,7 +151,7 @@ static int _manual_temp(Hcntrl ih){
 	int val = IupGetInt(ih,"VALUE");
 	int rounded = 100*((int)(val/100.0f));
 	LOG(LOGVERBOSE,_("Setting manual temperature: %d"),rounded);
-	(void)guigamma_set_temp(rounded);
+	(void)guigamma_set_target(rounded);
 	guimain_update_info();
 	return IUP_DEFAULT;
 }
@@ -52,7 +52,7 @@ static int _val_day_changed(Hcntrl ih){
 	int val = IupGetInt(ih,"VALUE");
 	int rounded = 100*((int)(val/100.0f));
 	IupSetfAttribute(label_day,"TITLE","%d K",rounded);
-	(void)guigamma_set_temp(rounded);
+	(void)guigamma_set_target(rounded);
 	return IUP_DEFAULT;
 }
 
@@ -61,7 +61,7 @@ static int _val_night_changed(Hcntrl ih){
 	int val = IupGetInt(ih,"VALUE");
 	int rounded = 100*((int)(val/100.0f));
 	IupSetfAttribute(label_night,"TITLE","%d� K",rounded);
-	(void)guigamma_set_temp(rounded);
+	(void)guigamma_set_target(rounded);
 	return IUP_DEFAULT;
 }
 
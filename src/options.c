@@ -1,7 +1,9 @@
 #include "common.h"
+#include <ctype.h>
 #include "gamma.h"
 #include "options.h"
 #include "solar.h"
+#include "wptable.h"
 #include "gamma_vals.h"
 #define SIZEOF(X) (sizeof(X)/sizeof(X[0]))
 
@@ -27,12 +29,30 @@ typedef struct{
 	int crtc_num;
 	/**\brief Transition speed */
 	int trans_speed;
+	/**\brief Share of a transition spent writing ramps in % */
+	int trans_budget;
 	/**\brief Oneshot mode enabled? */
 	int one_shot;
+	/**\brief Resample master ramp to all CRTCs? */
+	int resample;
+	/**\brief Fit whole ramp when reading back temperature? */
+	int fit;
+	/**\brief Build transition ramps up front? */
+	int prebuild;
+	/**\brief Pause ramp writes while a fullscreen window is focused? */
+	int fullscreen;
+	/**\brief Window classes that never pause ramp writes */
+	/*@unique@*/ char fs_allow[MAX_CLASS_LIST];
+	/**\brief Window classes that pause ramp writes, empty for all */
+	/*@unique@*/ char fs_deny[MAX_CLASS_LIST];
 	/**\brief Console mode enabled? */
 	int nogui;
 	/**\brief Verbosity level */
 	int verbose;
+	/**\brief Ramp cache size in KB */
+	int cache_size;
+	/**\brief White point table file, empty for the built-in table */
+	/*@unique@*/ char wptable[LONGEST_PATH];
 #ifdef ENABLE_IUP
 	/**\brief Start GUI minimized */
 	int startmin;
@@ -50,6 +70,8 @@ typedef struct{
 } rs_opts;
 
 static rs_opts Rs_opts;
+/* Copy kept by opt_save(), owns its own map */
+static rs_opts Rs_saved;
 static pair default_map[]={
 	{177.0,	100},
 	{3.0,	100},
@@ -57,6 +79,46 @@ static pair default_map[]={
 	{-174.0,0},
 };
 
+/* Dense elevation map, rebuilt whenever the map changes */
+static float map_table[MAP_TABLE_SIZE];
+
+// Compiles a map into map_table
+// The map and the table are walked together from the highest elevation
+// down, so any number of points costs one pass.  The last and first
+// points wrap around by 360 degrees.
+static void opt_compile_map(const pair *map, int size){
+	double prevelev=map[size-1].elev+360.0;
+	double prevtemp=map[size-1].temp;
+	double currelev=map[0].elev;
+	double currtemp=map[0].temp;
+	double elevation;
+	int i;
+	int j=0;
+	for( i=MAP_TABLE_SIZE-1; i>=0; --i ){
+		elevation = MAP_TABLE_MIN+i*MAP_TABLE_STEP;
+		// Segment from prev down to curr holding the elevation
+		while( (elevation<currelev) && (j<size) ){
+			prevelev = currelev;
+			prevtemp = currtemp;
+			if( ++j==size ){
+				currelev = map[0].elev-360.0;
+				currtemp = map[0].temp;
+			}else{
+				currelev = map[j].elev;
+				currtemp = map[j].temp;
+			}
+		}
+		if( (elevation>prevelev) || (elevation<currelev) )
+			map_table[i] = 0.0f;
+		else if( prevelev==currelev )
+			map_table[i] = (float)currtemp;
+		else
+			map_table[i] = (float)((elevation-currelev)/(prevelev-currelev)
+				*(prevtemp-currtemp)+currtemp);
+	}
+	LOG(LOGVERBOSE,_("Compiled %d point temperature map"),size);
+}
+
 /* Retrieves configuration file full path */
 int opt_get_config_file(char buffer[],size_t bufsize){
 #ifndef _WIN32
@@ -86,7 +148,10 @@ void opt_init(void){
 		free(Rs_opts.map);
 	Rs_opts.map=NULL;
 	(void)opt_set_verbose(0);
+	opt_compile_map(default_map,(int)SIZEOF(default_map));
 	(void)opt_set_brightness(1.0);
+	(void)opt_set_cache_size(DEFAULT_CACHE_SIZE);
+	(void)opt_set_wptable("");
 	(void)opt_set_location(0,0);
 	(void)opt_set_temperatures(DEFAULT_DAY_TEMP,DEFAULT_NIGHT_TEMP);
 	(void)opt_set_gamma(DEFAULT_GAMMA,DEFAULT_GAMMA,DEFAULT_GAMMA);
@@ -94,7 +159,14 @@ void opt_init(void){
 	(void)opt_set_screen(-1);
 	(void)opt_set_crtc(-1);
 	(void)opt_set_transpeed(1000);
+	(void)opt_set_trans_budget(DEFAULT_TRANS_BUDGET);
 	(void)opt_set_oneshot(0);
+	(void)opt_set_resample(0);
+	(void)opt_set_fit(0);
+	(void)opt_set_prebuild(0);
+	(void)opt_set_fullscreen(0);
+	(void)opt_set_fs_allow("");
+	(void)opt_set_fs_deny("");
 	(void)opt_set_nogui(0);
 #ifdef ENABLE_IUP
 	(void)opt_set_min(0);
@@ -111,6 +183,27 @@ int opt_set_brightness(double brightness){
 	return RET_FUN_SUCCESS;
 }
 
+// Sets the ramp cache size
+int opt_set_cache_size(int kbytes){
+	if( kbytes<0 ){
+		LOG(LOGERR,_("Invalid cache size: %d"),kbytes);
+		return RET_FUN_FAILED;
+	}
+	Rs_opts.cache_size = kbytes;
+	return RET_FUN_SUCCESS;
+}
+
+// Sets the white point table file
+int opt_set_wptable(const char *file){
+	if(file==NULL){
+		Rs_opts.wptable[0]='\0';
+		return RET_FUN_SUCCESS;
+	}
+	strncpy(Rs_opts.wptable,file,LONGEST_PATH-1);
+	Rs_opts.wptable[LONGEST_PATH-1]='\0';
+	return RET_FUN_SUCCESS;
+}
+
 // Sets the CRTC
 int opt_set_crtc(int val){
 	Rs_opts.crtc_num = val;
@@ -227,12 +320,100 @@ int opt_set_oneshot(int onoff){
 	return RET_FUN_SUCCESS;
 }
 
+// Sets resample mode
+int opt_set_resample(int onoff){
+	Rs_opts.resample = onoff;
+	return RET_FUN_SUCCESS;
+}
+
+// Sets ramp fitting mode
+int opt_set_fit(int onoff){
+	Rs_opts.fit = onoff;
+	return RET_FUN_SUCCESS;
+}
+
+// Sets transition ramp prebuilding
+int opt_set_prebuild(int onoff){
+	Rs_opts.prebuild = onoff;
+	return RET_FUN_SUCCESS;
+}
+
+// Sets fullscreen pausing
+int opt_set_fullscreen(int onoff){
+	Rs_opts.fullscreen = onoff;
+	return RET_FUN_SUCCESS;
+}
+
+// Copies a class list
+static int opt_set_class_list(char *list, const char *classes){
+	if( strlen(classes)>=MAX_CLASS_LIST ){
+		LOG(LOGERR,_("Window class list too long: %s"),classes);
+		return RET_FUN_FAILED;
+	}
+	strcpy(list,classes);
+	return RET_FUN_SUCCESS;
+}
+
+// Sets the window classes that never pause ramp writes
+int opt_set_fs_allow(const char *classes){
+	return opt_set_class_list(Rs_opts.fs_allow,classes);
+}
+
+// Sets the window classes that pause ramp writes
+int opt_set_fs_deny(const char *classes){
+	return opt_set_class_list(Rs_opts.fs_deny,classes);
+}
+
+// Checks whether a name is in a comma separated list, ignoring case
+static int opt_class_listed(const char *list, const char *name){
+	size_t len = strlen(name);
+	size_t i;
+	const char *end;
+
+	if( len==0 )
+		return 0;
+	while( *list!='\0' ){
+		end = strchr(list,',');
+		if( end==NULL )
+			end = list+strlen(list);
+		if( (size_t)(end-list)==len ){
+			for( i=0; (i<len) && (tolower((unsigned char)list[i])
+						==tolower((unsigned char)name[i])); ++i );
+			if( i==len )
+				return 1;
+		}
+		list = (*end==',') ? end+1 : end;
+	}
+	return 0;
+}
+
+// Checks whether a focused fullscreen window pauses ramp writes
+int opt_fullscreen_pauses(const char *instance, const char *wmclass){
+	if( opt_class_listed(Rs_opts.fs_allow,instance)
+			|| opt_class_listed(Rs_opts.fs_allow,wmclass) )
+		return 0;
+	if( Rs_opts.fs_deny[0]=='\0' )
+		return 1;
+	return opt_class_listed(Rs_opts.fs_deny,instance)
+		|| opt_class_listed(Rs_opts.fs_deny,wmclass);
+}
+
 // Sets transition - change in temperature per second
 int opt_set_transpeed(int tpersec){
 	Rs_opts.trans_speed = tpersec;
 	return RET_FUN_SUCCESS;
 }
 
+// Sets the transition budget
+int opt_set_trans_budget(int percent){
+	if( (percent<1) || (percent>100) ){
+		LOG(LOGERR,_("Invalid transition budget: %d%%"),percent);
+		return RET_FUN_FAILED;
+	}
+	Rs_opts.trans_budget = percent;
+	return RET_FUN_SUCCESS;
+}
+
 // Sets the screen to apply adjustment to
 int opt_set_screen(int val){
 	Rs_opts.screen_num = val;
@@ -309,6 +490,7 @@ int opt_parse_map(char *map){
 	char *currstr=map; /* Pointer string */
 	char *currsep,*currend;
 	int cnt=0;
+	int dense=0;
 	int i;
 	double prevelev=SOLAR_MAX_ANGLE;
 	pair *curr_map;
@@ -338,6 +520,8 @@ int opt_parse_map(char *map){
 			LOG(LOGERR,_("Invalid map line, elevation must be decreasing."));
 			return RET_FUN_FAILED;
 		}
+		if( (i>0) && (prevelev-curr_map[i].elev<MAP_TABLE_STEP) )
+			++dense;
 		prevelev = curr_map[i].elev;
 		if( (curr_map[i].temp>100.0)
 				/*@i@*/|| (curr_map[i].temp<0.0) ){
@@ -350,16 +534,24 @@ int opt_parse_map(char *map){
 				curr_map[i].temp);
 		currstr=++currend;
 	}
+	// Any number of points is fine, but the table only has so many entries
+	if( dense>0 )
+		LOG(LOGWARN,_("Map has %d points closer than %.1f degrees, they are"
+					" resampled to that resolution."),dense,MAP_TABLE_STEP);
 	if( Rs_opts.map )
 		free(Rs_opts.map);
 	Rs_opts.map = curr_map;
 	Rs_opts.map_size=cnt;
+	opt_compile_map(curr_map,cnt);
 	return RET_FUN_SUCCESS;
 }
 
 float opt_get_brightness(void)
 {return Rs_opts.brightness;}
 
+int opt_get_cache_size(void)
+{return Rs_opts.cache_size;}
+
 int opt_get_crtc(void)
 {return Rs_opts.crtc_num;}
 
@@ -381,9 +573,33 @@ gamma_method_t opt_get_method(void)
 int opt_get_oneshot(void)
 {return Rs_opts.one_shot;}
 
+int opt_get_resample(void)
+{return Rs_opts.resample;}
+
+int opt_get_fit(void)
+{return Rs_opts.fit;}
+
+char *opt_get_wptable(void)
+{return Rs_opts.wptable;}
+
+int opt_get_prebuild(void)
+{return Rs_opts.prebuild;}
+
+int opt_get_fullscreen(void)
+{return Rs_opts.fullscreen;}
+
+char *opt_get_fs_allow(void)
+{return Rs_opts.fs_allow;}
+
+char *opt_get_fs_deny(void)
+{return Rs_opts.fs_deny;}
+
 int opt_get_trans_speed(void)
 {return Rs_opts.trans_speed;}
 
+int opt_get_trans_budget(void)
+{return Rs_opts.trans_budget;}
+
 int opt_get_screen(void)
 {return Rs_opts.screen_num;}
 
@@ -420,7 +636,15 @@ pair *opt_get_map(int *size){
 	}
 }
 
+const float *opt_get_map_table(int *size){
+	(*size)=MAP_TABLE_SIZE;
+	return map_table;
+}
+
 temp_gamma *opt_get_gammap(int *size){
+	temp_gamma *table = wptable_get(size);
+	if( table!=NULL )
+		return table;
 	(*size)=(int)SIZEOF(blackbody_color);
 	return blackbody_color;
 }
@@ -436,14 +660,34 @@ void opt_write_config(void){
 	fid_config = fopen(Config_file,"w");
 	if( fid_config==NULL )
 		return;
+#ifdef ENABLE_IUP
 	if( opt_get_min()!=0 )
 		fprintf(fid_config,"min\n");
 	if( opt_get_disabled()!=0 )
 		fprintf(fid_config,"disable\n");
+#endif//ENABLE_IUP
 	fprintf(fid_config,"temps=%d:%d\n",opt_get_temp_day(),opt_get_temp_night());
 	fprintf(fid_config,"latlon=%f:%f\n",opt_get_lat(),opt_get_lon());
 	fprintf(fid_config,"speed=%d\n",opt_get_trans_speed());
+	if( opt_get_trans_budget()!=DEFAULT_TRANS_BUDGET )
+		fprintf(fid_config,"budget=%d\n",opt_get_trans_budget());
 	fprintf(fid_config,"method=%s\n",gamma_get_method_name(opt_get_method()));
+	if( opt_get_resample()!=0 )
+		fprintf(fid_config,"resample\n");
+	if( opt_get_fit()!=0 )
+		fprintf(fid_config,"fit\n");
+	if( opt_get_prebuild()!=0 )
+		fprintf(fid_config,"prebuild\n");
+	if( opt_get_fullscreen()!=0 )
+		fprintf(fid_config,"fullscreen\n");
+	if( opt_get_fs_allow()[0]!='\0' )
+		fprintf(fid_config,"fsallow=%s\n",opt_get_fs_allow());
+	if( opt_get_fs_deny()[0]!='\0' )
+		fprintf(fid_config,"fsdeny=%s\n",opt_get_fs_deny());
+	if( opt_get_cache_size()!=DEFAULT_CACHE_SIZE )
+		fprintf(fid_config,"cache=%d\n",opt_get_cache_size());
+	if( opt_get_wptable()[0]!='\0' )
+		fprintf(fid_config,"table=%s\n",opt_get_wptable());
 	if( Rs_opts.map ){
 		int i;
 		fprintf(fid_config,"map=");
@@ -454,9 +698,158 @@ void opt_write_config(void){
 	(void)fclose(fid_config);
 }
 
+// Copies a map, NULL stays NULL
+static /*@null@*/ pair *opt_map_copy(/*@null@*/ const pair *map, int size){
+	pair *copy;
+	if( !map )
+		return NULL;
+	copy = (pair*)malloc(sizeof(pair)*size);
+	if( copy )
+		memcpy(copy,map,sizeof(pair)*size);
+	return copy;
+}
+
+// Whether two option sets use the same map
+static int opt_map_equal(const rs_opts *a, const rs_opts *b){
+	if( !a->map || !b->map )
+		return (a->map==b->map);
+	return (a->map_size==b->map_size)
+		&& (memcmp(a->map,b->map,sizeof(pair)*a->map_size)==0);
+}
+
+/* Keeps a copy of the current options */
+int opt_save(void){
+	if( Rs_saved.map )
+		free(Rs_saved.map);
+	Rs_saved = Rs_opts;
+	Rs_saved.map = opt_map_copy(Rs_opts.map,Rs_opts.map_size);
+	if( Rs_opts.map && !Rs_saved.map ){
+		LOG(LOGERR,_("Memory allocation error."));
+		return RET_FUN_FAILED;
+	}
+	return RET_FUN_SUCCESS;
+}
+
+/* Compares the current options with the saved copy */
+int opt_diff(void){
+	const rs_opts *a = &Rs_saved;
+	const rs_opts *b = &Rs_opts;
+	int changed = 0;
+
+	if( (a->lat!=b->lat) || (a->lon!=b->lon) || (a->temp_day!=b->temp_day)
+			|| (a->temp_night!=b->temp_night) || !opt_map_equal(a,b) )
+		changed |= OPT_CHANGED_TARGET;
+	if( (a->brightness!=b->brightness) || (a->gamma.r!=b->gamma.r)
+			|| (a->gamma.g!=b->gamma.g) || (a->gamma.b!=b->gamma.b) )
+		changed |= OPT_CHANGED_COLOR;
+	if( strcmp(a->wptable,b->wptable)!=0 )
+		changed |= OPT_CHANGED_WPTABLE;
+	if( a->cache_size!=b->cache_size )
+		changed |= OPT_CHANGED_CACHE;
+	if( (a->trans_speed!=b->trans_speed)
+			|| (a->trans_budget!=b->trans_budget)
+			|| (a->prebuild!=b->prebuild) )
+		changed |= OPT_CHANGED_TRANSITION;
+	if( (strcmp(a->fs_allow,b->fs_allow)!=0)
+			|| (strcmp(a->fs_deny,b->fs_deny)!=0) )
+		changed |= OPT_CHANGED_WINDOWS;
+	if( (a->method!=b->method) || (a->screen_num!=b->screen_num)
+			|| (a->crtc_num!=b->crtc_num) || (a->fullscreen!=b->fullscreen) )
+		changed |= OPT_CHANGED_DISPLAY;
+	if( (a->nogui!=b->nogui) || (a->one_shot!=b->one_shot)
+#ifdef ENABLE_IUP
+			|| (a->startmin!=b->startmin)
+			|| (a->startdisabled!=b->startdisabled)
+			|| (strcmp(a->active_icon,b->active_icon)!=0)
+			|| (strcmp(a->idle_icon,b->idle_icon)!=0)
+#endif//ENABLE_IUP
+			)
+		changed |= OPT_CHANGED_MODE;
+	if( (a->verbose!=b->verbose) || (a->resample!=b->resample)
+			|| (a->fit!=b->fit) )
+		changed |= OPT_CHANGED_OTHER;
+	return changed;
+}
+
+/* Puts back groups of options from the saved copy */
+void opt_restore(int groups){
+	const rs_opts *a = &Rs_saved;
+	pair *map;
+
+	if( groups & OPT_CHANGED_TARGET ){
+		Rs_opts.lat = a->lat;
+		Rs_opts.lon = a->lon;
+		Rs_opts.temp_day = a->temp_day;
+		Rs_opts.temp_night = a->temp_night;
+		map = opt_map_copy(a->map,a->map_size);
+		if( Rs_opts.map )
+			free(Rs_opts.map);
+		Rs_opts.map = map;
+		Rs_opts.map_size = map ? a->map_size : 0;
+		if( map )
+			opt_compile_map(map,Rs_opts.map_size);
+		else
+			opt_compile_map(default_map,(int)SIZEOF(default_map));
+	}
+	if( groups & OPT_CHANGED_COLOR ){
+		Rs_opts.brightness = a->brightness;
+		Rs_opts.gamma = a->gamma;
+	}
+	if( groups & OPT_CHANGED_WPTABLE )
+		strcpy(Rs_opts.wptable,a->wptable);
+	if( groups & OPT_CHANGED_CACHE )
+		Rs_opts.cache_size = a->cache_size;
+	if( groups & OPT_CHANGED_TRANSITION ){
+		Rs_opts.trans_speed = a->trans_speed;
+		Rs_opts.trans_budget = a->trans_budget;
+		Rs_opts.prebuild = a->prebuild;
+	}
+	if( groups & OPT_CHANGED_WINDOWS ){
+		strcpy(Rs_opts.fs_allow,a->fs_allow);
+		strcpy(Rs_opts.fs_deny,a->fs_deny);
+	}
+	if( groups & OPT_CHANGED_DISPLAY ){
+		Rs_opts.method = a->method;
+		Rs_opts.screen_num = a->screen_num;
+		Rs_opts.crtc_num = a->crtc_num;
+		Rs_opts.fullscreen = a->fullscreen;
+	}
+	if( groups & OPT_CHANGED_MODE ){
+		Rs_opts.nogui = a->nogui;
+		Rs_opts.one_shot = a->one_shot;
+#ifdef ENABLE_IUP
+		Rs_opts.startmin = a->startmin;
+		Rs_opts.startdisabled = a->startdisabled;
+		strcpy(Rs_opts.active_icon,a->active_icon);
+		strcpy(Rs_opts.idle_icon,a->idle_icon);
+#endif//ENABLE_IUP
+	}
+	if( groups & OPT_CHANGED_OTHER ){
+		(void)opt_set_verbose(a->verbose);
+		Rs_opts.resample = a->resample;
+		Rs_opts.fit = a->fit;
+	}
+}
+
+/* Name of an option group */
+const char *opt_changed_name(int group){
+	static const char *names[] = {"target","color","wptable","cache",
+		"transition","windows","display","mode","other"};
+	int i;
+
+	for( i=0; i<(int)SIZEOF(names); ++i )
+		if( group==(1<<i) )
+			return names[i];
+	return "unknown";
+}
+
 /* Frees resources used by options */
 void opt_free(void){
 	LOG(LOGVERBOSE,_("Freeing options"));
 	if( Rs_opts.map )
 		free(Rs_opts.map);
+	if( Rs_saved.map )
+		free(Rs_saved.map);
+	Rs_opts.map = NULL;
+	Rs_saved.map = NULL;
 }
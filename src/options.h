@@ -21,6 +21,31 @@
 
 /**\brief Default transition speed */
 #define DEFAULT_TRANSPEED   1000
+/**\brief Default share of a transition spent writing ramps in % */
+#define DEFAULT_TRANS_BUDGET 10
+/**\brief Longest list of window classes */
+#define MAX_CLASS_LIST 256
+
+/**\brief Location, temperatures or map changed: the target moves */
+#define OPT_CHANGED_TARGET	0x01
+/**\brief Brightness or gamma tweak changed */
+#define OPT_CHANGED_COLOR	0x02
+/**\brief White point table changed */
+#define OPT_CHANGED_WPTABLE	0x04
+/**\brief Ramp cache size changed */
+#define OPT_CHANGED_CACHE	0x08
+/**\brief Transition speed, budget or prebuild changed */
+#define OPT_CHANGED_TRANSITION	0x10
+/**\brief Fullscreen window class lists changed */
+#define OPT_CHANGED_WINDOWS	0x20
+/**\brief Method, screen, CRTC or fullscreen watch changed */
+#define OPT_CHANGED_DISPLAY	0x40
+/**\brief Console, oneshot or GUI start options changed */
+#define OPT_CHANGED_MODE	0x80
+/**\brief Verbosity, resample or fit changed */
+#define OPT_CHANGED_OTHER	0x100
+/**\brief All options */
+#define OPT_CHANGED_ALL		0x1ff
 
 /**\brief Retrieves full path of the configuration file.
  * \param buffer buffer to store the configuration file.
@@ -37,6 +62,11 @@ void opt_init(void);
  */
 int opt_set_brightness(double brightness);
 
+/**\brief Sets the ramp cache memory limit.
+ * \param kbytes size in KB, 0 disables the cache
+ */
+int opt_set_cache_size(int kbytes);
+
 /**\brief Sets the CRTC to apply adjustment to.
  * \param val integer value of CRTC
  */
@@ -88,11 +118,56 @@ int opt_parse_method(char *val);
  */
 int opt_set_oneshot(int onoff);
 
+/**\brief Sets transition ramp prebuilding
+ * \param onoff set to 1 to build all ramps of a transition when it starts
+ * instead of on every step
+ */
+int opt_set_prebuild(int onoff);
+
+/**\brief Sets pausing ramp writes while a fullscreen window is focused
+ * \param onoff set to 1 to enable (X only)
+ */
+int opt_set_fullscreen(int onoff);
+
+/**\brief Sets the window classes that never pause ramp writes
+ * \param classes comma separated WM_CLASS names or instances
+ */
+int opt_set_fs_allow(const char *classes);
+
+/**\brief Sets the window classes that pause ramp writes
+ * \param classes comma separated WM_CLASS names or instances, empty for
+ * all classes not in the allow list
+ */
+int opt_set_fs_deny(const char *classes);
+
 /**\brief Sets transition speed
  * \param tpersec temperature per second, defaults to 100k/s
  */
 int opt_set_transpeed(int tpersec);
 
+/**\brief Sets the transition budget
+ * \param percent share of a transition spent writing ramps (1 - 100), the
+ * step period grows with the measured commit latency to stay within it
+ */
+int opt_set_trans_budget(int percent);
+
+/**\brief Sets resample mode (one master ramp shared by all CRTCs)
+ * \param onoff set to 1 to enable
+ */
+int opt_set_resample(int onoff);
+
+/**\brief Sets ramp fitting mode
+ * \param onoff set to 1 to estimate the current temperature from a fit of
+ * the whole ramp instead of its end points
+ */
+int opt_set_fit(int onoff);
+
+/**\brief Sets the white point table file
+ * \param file table written by genwhitepoint -f binary, empty for the
+ * built-in table
+ */
+int opt_set_wptable(const char *file);
+
 /**\brief Sets the screen to apply adjustment to.
  * \param val integer value of the screen.
  */
@@ -138,6 +213,7 @@ int opt_set_idle_icon(const char *icon);
 #endif
 
 /**\brief Parses temperature map
+ * \details The map is compiled into a dense table, see opt_get_map_table().
  * \param map String containing new temperature map.
  */
 int opt_parse_map(char *map);
@@ -145,6 +221,9 @@ int opt_parse_map(char *map);
 /**\brief Retrieves brightness */
 float opt_get_brightness(void);
 
+/**\brief Retrieves ramp cache size in KB */
+int opt_get_cache_size(void);
+
 /**\brief Retrieves CRTC */
 int opt_get_crtc(void);
 
@@ -166,9 +245,40 @@ gamma_method_t opt_get_method(void);
 /**\brief Retrieves oneshot mode */
 int opt_get_oneshot(void);
 
+/**\brief Retrieves transition ramp prebuilding */
+int opt_get_prebuild(void);
+
+/**\brief Retrieves fullscreen pausing */
+int opt_get_fullscreen(void);
+
+/**\brief Retrieves the window classes that never pause ramp writes */
+/*@dependent@*/ char *opt_get_fs_allow(void);
+
+/**\brief Retrieves the window classes that pause ramp writes */
+/*@dependent@*/ char *opt_get_fs_deny(void);
+
+/**\brief Checks whether a focused fullscreen window pauses ramp writes
+ * \param instance WM_CLASS instance name
+ * \param wmclass WM_CLASS class name
+ * \return 1 if ramp writes should pause
+ */
+int opt_fullscreen_pauses(const char *instance, const char *wmclass);
+
 /**\brief Retrieves transition speed */
 int opt_get_trans_speed(void);
 
+/**\brief Retrieves transition budget in % */
+int opt_get_trans_budget(void);
+
+/**\brief Retrieves resample mode */
+int opt_get_resample(void);
+
+/**\brief Retrieves ramp fitting mode */
+int opt_get_fit(void);
+
+/**\brief Retrieves white point table file */
+/*@dependent@*/ char *opt_get_wptable(void);
+
 /**\brief Retrieves screen */
 int opt_get_screen(void);
 
@@ -198,12 +308,37 @@ int opt_get_disabled(void);
 /**\brief Retrieves current temperature map */
 /*@dependent@*/ pair *opt_get_map(/*@out@*/ int *size);
 
+/**\brief Retrieves the compiled temperature map
+ * \details Entry i holds the temperature percentage at elevation
+ * MAP_TABLE_MIN+i*MAP_TABLE_STEP, it is rebuilt whenever the map changes.
+ */
+/*@observer@*/ const float *opt_get_map_table(/*@out@*/ int *size);
+
 /**\brief Retrieves current gamma map */
 /*@dependent@*/ temp_gamma *opt_get_gammap(/*@out@*/ int *size);
 
 /**\brief Writes the configuration file with current settings */
 void opt_write_config(void);
 
+/**\brief Keeps a copy of the current options
+ * \details For a reload: save, parse the options again, then compare with
+ * opt_diff() and put back what cannot be applied with opt_restore().
+ */
+int opt_save(void);
+
+/**\brief Compares the current options with the saved copy
+ * \return OPT_CHANGED_* groups that differ
+ */
+int opt_diff(void);
+
+/**\brief Puts back groups of options from the saved copy
+ * \param groups OPT_CHANGED_* groups, OPT_CHANGED_ALL for everything
+ */
+void opt_restore(int groups);
+
+/**\brief Name of one OPT_CHANGED_* group, for messages */
+/*@observer@*/ const char *opt_changed_name(int group);
+
 /**\brief Frees resources used by options */
 void opt_free(void);
 
@@ -4,16 +4,26 @@
 
 #include "common.h"
 #include "gamma.h"
+#include "wptable.h"
 #include "options.h"
 #include "solar.h"
 #include "location.h"
 #include "systemtime.h"
+#include "transition.h"
+#include "evloop.h"
+#include "control.h"
+#include "status.h"
+#include "follow.h"
+#include "cfgwatch.h"
 #include "netutils.h"
 #include "thirdparty/argparser.h"
 
 #ifdef HAVE_SYS_SIGNAL_H
 # include <sys/signal.h>
 #endif
+#ifdef HAVE_EVLOOP
+# include <signal.h>
+#endif
 
 #if defined(ENABLE_IUP)
 # include "gui/iupgui.h"
@@ -45,8 +55,34 @@
 static int _parse_options(int argc, char *argv[]){
 	(void)args_addarg("b","bright",
 		_("<BRIGHTNESS> Brightness (0.1 - 1)"),ARGVAL_STRING);
+	(void)args_addarg(NULL,"budget",
+		_("<PERCENT> Share of a transition spent writing ramps (default 10)"),ARGVAL_STRING);
+	(void)args_addarg(NULL,"cache",
+		_("<KB> Gamma ramp cache size (0 to disable)"),ARGVAL_STRING);
 	(void)args_addarg("c","crt",
 		_("<CRTC> CRTC to apply adjustment to (RANDR only)"),ARGVAL_STRING);
+#ifdef HAVE_EVLOOP
+	(void)args_addarg(NULL,"ctl",
+		_("<COMMAND> Send a command to the running console mode and exit"
+			" (temp K, bright B, pause, resume, status, reload)"),ARGVAL_STRING);
+#endif//HAVE_EVLOOP
+	(void)args_addarg(NULL,"fit",
+		_("Read back temperature by fitting the whole ramp"),ARGVAL_NONE);
+#ifdef HAVE_EVLOOP
+	(void)args_addarg(NULL,"follow",
+		_("<FORMAT> Write a line on stdout for each change in console mode"
+			" (json, tsv)"),ARGVAL_STRING);
+	(void)args_addarg(NULL,"followhz",
+		_("<RATE> Most lines per second written by --follow (default 10)"),ARGVAL_STRING);
+	(void)args_addarg(NULL,"followto",
+		_("<FILE> Write --follow lines to a FIFO or file instead"),ARGVAL_STRING);
+#endif//HAVE_EVLOOP
+	(void)args_addarg(NULL,"fullscreen",
+		_("Pause ramp writes while a fullscreen window is focused (X only)"),ARGVAL_NONE);
+	(void)args_addarg(NULL,"fsallow",
+		_("<CLASSES> Window classes that never pause ramp writes"),ARGVAL_STRING);
+	(void)args_addarg(NULL,"fsdeny",
+		_("<CLASSES> Only these window classes pause ramp writes"),ARGVAL_STRING);
 	(void)args_addarg("g","gamma",
 		_("<R:G:B> Additional gamma correction to apply"),ARGVAL_STRING);
 	(void)args_addarg("l","latlon",
@@ -57,10 +93,16 @@ static int _parse_options(int argc, char *argv[]){
 		_("Run in console mode (no GUI)."),ARGVAL_NONE);
 	(void)args_addarg("o","oneshot",
 		_("Adjust color and then exit (no GUI)"),ARGVAL_NONE);
+	(void)args_addarg(NULL,"prebuild",
+		_("Build all ramps of a transition when it starts"),ARGVAL_NONE);
+	(void)args_addarg(NULL,"resample",
+		_("Compute one ramp and resample it for every CRTC (RANDR only)"),ARGVAL_NONE);
 	(void)args_addarg("r","speed",
 		_("<SPEED> Transition speed (default 1000 K/s)"),ARGVAL_STRING);
 	(void)args_addarg("s","screen",
 		_("<SCREEN> Screen to apply to"),ARGVAL_STRING);
+	(void)args_addarg(NULL,"table",
+		_("<FILE> White point table (see genwhitepoint -f binary)"),ARGVAL_STRING);
 	(void)args_addarg("t","temps",
 		_("<DAY:NIGHT> Color temperature to set at daytime/night"),ARGVAL_STRING);
 	(void)args_addarg("v","verbose",
@@ -103,8 +145,20 @@ static int _parse_options(int argc, char *argv[]){
 				|| err;
 		if( (val=args_getnamed("b")) )
 			err = (!opt_set_brightness(atof(val))) || err;
+		if( (val=args_getnamed("budget")) )
+			err = (!opt_set_trans_budget(atoi(val))) || err;
+		if( (val=args_getnamed("cache")) )
+			err = (!opt_set_cache_size(atoi(val))) || err;
 		if( (val=args_getnamed("c")) )
 			err = (!opt_set_crtc(atoi(val))) || err;
+		if( (val=args_getnamed("fit")) )
+			err = (!opt_set_fit(1)) || err;
+		if( (val=args_getnamed("fullscreen")) )
+			err = (!opt_set_fullscreen(1)) || err;
+		if( (val=args_getnamed("fsallow")) )
+			err = (!opt_set_fs_allow(val)) || err;
+		if( (val=args_getnamed("fsdeny")) )
+			err = (!opt_set_fs_deny(val)) || err;
 		if( (val=args_getnamed("g")) )
 			err = (!opt_parse_gamma(val)) || err;
 		if( (val=args_getnamed("l")) )
@@ -115,10 +169,16 @@ static int _parse_options(int argc, char *argv[]){
 			err = (!opt_parse_method(val)) || err;
 		if( (val=args_getnamed("o")) )
 			err = (!opt_set_oneshot(1) ) || err;
+		if( (val=args_getnamed("prebuild")) )
+			err = (!opt_set_prebuild(1)) || err;
+		if( (val=args_getnamed("resample")) )
+			err = (!opt_set_resample(1)) || err;
 		if( (val=args_getnamed("r")) )
 			err = (!opt_set_transpeed(atoi(val))) || err;
 		if( (val=args_getnamed("s")) )
 			err = (!opt_set_screen(atoi(val))) || err;
+		if( (val=args_getnamed("table")) )
+			err = (!opt_set_wptable(val)) || err;
 		if( (val=args_getnamed("t")) )
 			err = (!opt_parse_temperatures(val)) || err;
 #ifdef ENABLE_IUP
@@ -157,19 +217,436 @@ static int _do_oneshot(void){
 	return RET_FUN_SUCCESS;
 }
 
+/* Longest console sleep, ramps are rewritten at least this often in case
+   another program replaced them */
+#define CONSOLE_MAX_SLEEP (60*20)
+
+#ifdef HAVE_EVLOOP
+/**\brief Console daemon state */
+typedef struct{
+	/**\brief Transition to the current target */
+	transition_s trans;
+	/**\brief Exit signals received so far */
+	int exiting;
+	/**\brief Display connection, -1 if not watched */
+	int fd;
+	/**\brief Temperature set with the temp command, 0 to follow the sun */
+	int manual;
+	/**\brief Changes held with the pause command? */
+	int held;
+	/**\brief Target of the last update */
+	int target;
+	/**\brief Deadline of the console itself */
+	double wake;
+	/**\brief When a coalesced follow line is due, negative if none */
+	double follow_due;
+} console_s;
+
+static console_s console;
+
+/* Command line, parsed again on reloads */
+static int console_argc;
+/*@null@*/ static char **console_argv;
+
+/* Temperature on screen, requests made while paused are not */
+static int console_shown(void){
+	return gamma_state_paused() ? gamma_state_get_temperature()
+		: console.trans.curr;
+}
+
+/* Publishes the state to the status segment */
+static void console_publish(void){
+	status_s state;
+	double now;
+
+	if( !systemtime_get_time(&state.updated) )
+		state.updated = 0.0;
+	state.suppressed = gamma_pause_suppressed();
+	state.temp = console_shown();
+	state.target = transition_active(&console.trans)
+		? console.trans.target : console.target;
+	if( console.exiting ){
+		state.target = DEFAULT_DAY_TEMP;
+		state.mode = STATUS_MODE_EXITING;
+	}
+	else if( console.held )
+		state.mode = STATUS_MODE_HOLD;
+	else if( console.manual )
+		state.mode = STATUS_MODE_MANUAL;
+	else
+		state.mode = STATUS_MODE_AUTO;
+	state.paused = gamma_state_paused();
+	state.brightness = (float)opt_get_brightness();
+	state.elevation = (float)solar_elevation(state.updated,
+			opt_get_lat(),opt_get_lon());
+	status_publish(&state);
+	if( transition_now(&now) )
+		console.follow_due = follow_update(&state,now);
+}
+
+/* Arms the deadline, earlier if a follow line waits for its turn */
+static void console_arm(double deadline){
+	console.wake = deadline;
+	if( (console.follow_due>=0.0) && (console.follow_due<deadline) )
+		deadline = console.follow_due;
+	(void)evloop_set_deadline(deadline);
+}
+
+/* Arms the deadline for whatever the console waits on next */
+static void console_schedule(void){
+	double now;
+	double wall;
+	double next;
+
+	// Every change ends up here
+	console_publish();
+	if( transition_active(&console.trans) ){
+		console_arm(transition_next_deadline(&console.trans));
+		return;
+	}
+	// Exit transition done
+	if( console.exiting ){
+		evloop_quit();
+		return;
+	}
+	if( !transition_now(&now) ){
+		evloop_quit();
+		return;
+	}
+	// Sleep until the target moves by a noticeable step
+	if( systemtime_get_time(&wall) ){
+		next = gamma_calc_next_change(opt_get_lat(),opt_get_lon(),
+			opt_get_temp_day(),opt_get_temp_night(),wall,
+			TRANSITION_JND,CONSOLE_MAX_SLEEP);
+		LOG(LOGVERBOSE,_("Sleeping %.0fs until the next temperature change"),
+				next-wall);
+		console_arm(now+(next-wall));
+	}else
+		console_arm(now+1.0);
+}
+
+/* Temperature the console heads for */
+static int console_target(void){
+	if( console.manual )
+		return console.manual;
+	return gamma_calc_curr_target_temp(
+		opt_get_lat(),opt_get_lon(),
+		opt_get_temp_day(),opt_get_temp_night());
+}
+
+/* Heads for the current target, rewrites the ramps if already there */
+static void console_retarget(void){
+	int target_temp;
+	double now;
+
+	if( !transition_active(&console.trans) )
+		transition_init(&console.trans,gamma_state_get_temperature());
+	if( console.held ){
+		console.target = console.trans.curr;
+		// Still rewrite what is held
+		if( !gamma_state_set_temperature(console.trans.curr,opt_get_gamma()) )
+			LOG(LOGERR,_("Temperature adjustment failed."));
+		return;
+	}
+	target_temp=console_target();
+	console.target = target_temp;
+	if( !transition_active(&console.trans)
+			&& (console.trans.curr==target_temp) ){
+		if( !gamma_state_set_temperature(target_temp,opt_get_gamma()) )
+			LOG(LOGERR,_("Temperature adjustment failed."));
+	}else if( transition_now(&now) )
+		transition_set_target(&console.trans,target_temp,
+				opt_get_trans_speed(),now);
+}
+
+/* Moves towards the temperature due now */
+static void console_update(void){
+	// Another program may have replaced our ramps meanwhile
+	gamma_force_refresh();
+	console_retarget();
+}
+
+/* Parses the options again and applies only what changed */
+static int console_reload(const char *why){
+	char names[128];
+	double start = 0.0;
+	double end = 0.0;
+	size_t len = 0;
+	int changed;
+	int restart;
+	int i;
+
+	(void)systemtime_get_monotonic(&start);
+	if( !opt_save() )
+		return RET_FUN_FAILED;
+	args_free();
+	if( !_parse_options(console_argc,console_argv) ){
+		opt_restore(OPT_CHANGED_ALL);
+		LOG(LOGERR,_("Reload failed, keeping the running options"));
+		return RET_FUN_FAILED;
+	}
+	changed = opt_diff();
+	// These need the display set up again
+	restart = changed & (OPT_CHANGED_DISPLAY|OPT_CHANGED_MODE);
+	if( restart ){
+		opt_restore(restart);
+		LOG(LOGWARN,_("Restart to apply the changed %s options"),
+				(restart & OPT_CHANGED_DISPLAY) ? _("display") : _("mode"));
+		changed &= ~restart;
+	}
+	if( changed & OPT_CHANGED_CACHE )
+		gamma_cache_set_limit((size_t)opt_get_cache_size()*1024);
+	if( changed & OPT_CHANGED_WPTABLE ){
+		if( (opt_get_wptable()[0]=='\0') || !wptable_load(opt_get_wptable()) ){
+			if( opt_get_wptable()[0]!='\0' )
+				LOG(LOGWARN,_("Using built-in white point table"));
+			wptable_free();
+		}
+	}
+	// The target is recomputed, the ramps only rewritten for new colors
+	if( changed & OPT_CHANGED_TARGET )
+		console_retarget();
+	else if( (changed & (OPT_CHANGED_COLOR|OPT_CHANGED_WPTABLE))
+			&& !transition_active(&console.trans)
+			&& !gamma_state_set_temperature(console.trans.curr,opt_get_gamma()) )
+		LOG(LOGERR,_("Temperature adjustment failed."));
+	(void)systemtime_get_monotonic(&end);
+	names[0] = '\0';
+	for( i=0; (1<<i)<=OPT_CHANGED_ALL; ++i )
+		if( (changed & (1<<i)) && (len<sizeof(names)) )
+			len += (size_t)snprintf(names+len,sizeof(names)-len,"%s%s",
+					len ? "," : "",opt_changed_name(1<<i));
+	LOG(LOGINFO,_("Reloaded options (%s) in %.2fms, changed: %s"),why,
+			(end-start)*1000.0,changed ? names : _("nothing"));
+	return RET_FUN_SUCCESS;
+}
+
+/* Starts the exit transition, a second exit signal skips it */
+static void console_exit(void){
+	double now;
+
+	if( console.exiting++ || !transition_now(&now) ){
+		evloop_quit();
+		return;
+	}
+	if( !transition_active(&console.trans) )
+		transition_init(&console.trans,gamma_state_get_temperature());
+	// Use a constant 2000K/s transition speed to exit, an interrupted
+	// transition turns around from where it is
+	transition_set_target(&console.trans,DEFAULT_DAY_TEMP,2000,now);
+	console_schedule();
+}
+
+/* Deadline expired: next transition step or target check */
+static void console_on_timer(/*@unused@*/ void *data){
+	double now;
+
+	// Only a follow line was due
+	if( transition_now(&now) && (now<console.wake) ){
+		console_schedule();
+		return;
+	}
+	if( !transition_active(&console.trans) ){
+		console_update();
+	}else if( transition_now(&now)
+			&& !transition_tick(&console.trans,now) ){
+		LOG(LOGERR,_("Temperature adjustment failed."));
+		console_exit();
+		return;
+	}
+	console_schedule();
+}
+
+/* Exit signals and SIGHUP */
+static void console_on_signal(int signo, /*@unused@*/ void *data){
+	if( signo!=SIGHUP ){
+		console_exit();
+		return;
+	}
+	// Reload and recheck the target at once, e.g. after a manual clock
+	// change
+	if( !console.exiting ){
+		(void)console_reload("SIGHUP");
+		console_update();
+		console_schedule();
+	}
+}
+
+/* Control socket commands */
+static void console_on_command(const char *cmd, char *reply, size_t size,
+		/*@unused@*/ void *data){
+	double bright = 0.0;
+	int temp = 0;
+	int is_temp;
+	int is_bright;
+
+	if( strcmp(cmd,"status")==0 ){
+		(void)snprintf(reply,size,"ok temp=%d target=%d bright=%.2f"
+				" mode=%s paused=%d suppressed=%lu",console_shown(),
+				console.held ? console.trans.curr : console_target(),
+				opt_get_brightness(),console.held ? "hold"
+				: (console.manual ? "manual" : "auto"),gamma_state_paused(),
+				gamma_pause_suppressed());
+		return;
+	}
+	is_temp = (sscanf(cmd,"temp %d",&temp)==1);
+	is_bright = !is_temp && (sscanf(cmd,"bright %lf",&bright)==1);
+	if( !is_temp && !is_bright && (strcmp(cmd,"pause")!=0)
+			&& (strcmp(cmd,"resume")!=0) && (strcmp(cmd,"reload")!=0) ){
+		(void)snprintf(reply,size,"err unknown command: %s",cmd);
+		return;
+	}
+	LOG(LOGINFO,_("Control command: %s"),cmd);
+	// Nothing may change once the day ramps are being restored
+	if( console.exiting ){
+		(void)snprintf(reply,size,"err exiting");
+		return;
+	}
+	if( is_temp ){
+		if( (temp<MIN_TEMP) || (temp>MAX_TEMP) ){
+			(void)snprintf(reply,size,"err temperature out of range (%d-%d)",
+					MIN_TEMP,MAX_TEMP);
+			return;
+		}
+		console.manual = temp;
+		console.held = 0;
+	}else if( is_bright ){
+		if( (bright<0.1) || (bright>1.0) || !opt_set_brightness(bright) ){
+			(void)snprintf(reply,size,"err brightness out of range (0.1-1)");
+			return;
+		}
+	}else if( strcmp(cmd,"pause")==0 ){
+		// Stop where the transition is
+		if( transition_active(&console.trans) )
+			transition_init(&console.trans,console.trans.curr);
+		console.held = 1;
+	}else if( strcmp(cmd,"resume")==0 ){
+		console.manual = 0;
+		console.held = 0;
+	}
+	if( (strcmp(cmd,"reload")==0) && !console_reload("control socket") ){
+		(void)snprintf(reply,size,"err reload failed, see the log");
+		return;
+	}
+	console_update();
+	console_schedule();
+	(void)snprintf(reply,size,"ok");
+}
+
+/* Clock set or resumed from suspend: the schedule is stale */
+static void console_on_clock(/*@unused@*/ double jump,
+		/*@unused@*/ void *data){
+	if( console.exiting )
+		return;
+	// Head for the new target at the usual speed, no catching up on the
+	// time skipped
+	console_update();
+	console_schedule();
+}
+
+/* Configuration file written */
+static void console_on_config(/*@unused@*/ void *data){
+	if( console.exiting )
+		return;
+	(void)console_reload("inotify");
+	console_schedule();
+}
+
+/* Display events: drain them so the connection buffer cannot fill up */
+static void console_on_display(int fd, int events,
+		/*@unused@*/ void *data){
+	if( !(events & EVLOOP_ERR) && gamma_state_handle_events() ){
+		// Blanking or fullscreen may have paused or resumed writes
+		console_publish();
+		console_arm(console.wake);
+		return;
+	}
+	LOG(LOGERR,_("Display connection lost."));
+	(void)evloop_remove(fd);
+	console.fd = -1;
+	console.exiting = 2;
+	evloop_quit();
+}
+
+/* Change gamma continuously until break signal. */
+static int _do_console(void)
+{
+	evloop_stats_s stats;
+	double started = 0.0;
+	double now;
+	char config[LONGEST_PATH];
+	int ret = RET_FUN_SUCCESS;
+
+	transition_init(&console.trans,gamma_state_get_temperature());
+	LOG(LOGVERBOSE,_("Original temp: %dK"),console.trans.curr);
+	console.exiting = 0;
+	console.manual = 0;
+	console.held = 0;
+	console.target = console.trans.curr;
+	console.wake = -1.0;
+	console.follow_due = -1.0;
+	if( !evloop_init(&console_on_timer,&console_on_signal,&console_on_clock,
+				NULL) )
+		return RET_FUN_FAILED;
+	// Scripts can still use oneshot mode without it
+	if( !control_init(&console_on_command,NULL) )
+		LOG(LOGWARN,_("Control socket disabled"));
+	if( !status_init() )
+		LOG(LOGWARN,_("Status segment disabled"));
+	// SIGHUP and the control socket still reload without it
+	if( !opt_get_config_file(config,sizeof(config))
+			|| !cfgwatch_init(config,&console_on_config,NULL) )
+		LOG(LOGWARN,_("Configuration changes need a reload"));
+	console.fd = gamma_state_get_fd();
+	if( (console.fd>=0)
+			&& !evloop_add(console.fd,&console_on_display,NULL) )
+		console.fd = -1;
+	(void)transition_now(&started);
+	console_update();
+	console_schedule();
+	if( !evloop_run() )
+		ret = RET_FUN_FAILED;
+	evloop_get_stats(&stats);
+	if( transition_now(&now) && (now>started) )
+		LOG(LOGINFO,_("Console woke up %lu times in %.2fh (%.1f per hour)"),
+				stats.wakeups,(now-started)/3600.0,
+				stats.wakeups*3600.0/(now-started));
+	// Interrupted again or paused, jump straight to the target; unchanged
+	// ramps are skipped by the backend
+	if( !gamma_state_write_temperature(DEFAULT_DAY_TEMP,opt_get_gamma()) ){
+		LOG(LOGERR,_("Temperature adjustment failed."));
+		ret = RET_FUN_FAILED;
+	}
+	// Signals stay blocked until the ramps are restored
+	cfgwatch_end();
+	follow_end();
+	status_end();
+	control_end();
+	if( console.fd>=0 )
+		(void)evloop_remove(console.fd);
+	evloop_end();
+	return ret;
+}
+#else /* ! HAVE_EVLOOP */
 #ifdef _WIN32
 	static int exiting=0;
+	/* Set on exit events to wake the console up */
+	static HANDLE exit_event=NULL;
 	/* Signal handler for exit signals */
 	static BOOL CtrlHandler( DWORD fdwCtrlType ){
 		switch( fdwCtrlType ){
 		case CTRL_C_EVENT:
 			LOG(LOGINFO,_("Ctrl-C event."));
 			exiting=1;
+			if( exit_event )
+				(void)SetEvent(exit_event);
 			return( TRUE );
 		// CTRL-CLOSE: confirm that the user wants to exit.
 		case CTRL_CLOSE_EVENT:
 			LOG(LOGINFO,_("Ctrl-Close event."));
 			exiting=1;
+			if( exit_event )
+				(void)SetEvent(exit_event);
 			return( TRUE );
 		// Pass other signals to the next handler.
 		case CTRL_BREAK_EVENT:
@@ -187,9 +664,21 @@ static int _do_oneshot(void){
 	}
 	/* Register signal handler */
 	static void sig_register(void){
+		exit_event = CreateEvent(NULL,TRUE,FALSE,NULL);
 		if( !SetConsoleCtrlHandler( (PHANDLER_ROUTINE) CtrlHandler, TRUE ) )
 			LOG(LOGERR,_("Unable to register Control Handler."));
 	}
+	/* Sleeps until deadline or an exit event */
+	static void console_sleep_until(double deadline){
+		double now;
+		if( (exit_event==NULL) || !transition_now(&now) ){
+			(void)transition_sleep_until(deadline);
+			return;
+		}
+		if( deadline>now )
+			(void)WaitForSingleObject(exit_event,
+					(DWORD)((deadline-now)*1000.0+0.5));
+	}
 #elif defined(HAVE_SYS_SIGNAL_H)
 	static volatile sig_atomic_t exiting = 0;
 	/* Signal handler for exit signals */
@@ -210,73 +699,117 @@ static int _do_oneshot(void){
 	static int exiting = 0;
 #	define sig_register()
 #endif /* ! HAVE_SYS_SIGNAL_H */
+#ifndef _WIN32
+	/* Sleeps until deadline, exit signals interrupt the sleep */
+#	define console_sleep_until(deadline) \
+		(void)transition_sleep_until(deadline)
+#endif /* ! _WIN32 */
 
-static void transition_to_temp(int curr, int target, int speed){
-	int currtemp = curr;
+/* Runs a transition until it is done or interrupted */
+static int transition_run(transition_s *trans){
+	double now;
 
-	do{
-		if( curr > target ){
-			currtemp-=speed/10;
-			if( currtemp < target )
-				break;
-		}else{
-			currtemp+=speed/10;
-			if( currtemp > target )
-				break;
-		}
-
-		LOG(LOGVERBOSE,_("Transition color: %dK"),currtemp);
-		if( !gamma_state_set_temperature(currtemp,opt_get_gamma()) ){
+	while( !exiting && transition_active(trans) && transition_now(&now) ){
+		if( !transition_tick(trans,now) ){
 			LOG(LOGERR,_("Temperature adjustment failed."));
-			exiting = 1;
-			break;
+			return RET_FUN_FAILED;
 		}
-		/*@i@*/SLEEP(100);
-	}while(!exiting);
-
-	LOG(LOGVERBOSE,_("Target color reached: %dK"),target);
-	if( !gamma_state_set_temperature(target,opt_get_gamma()) ){
-		LOG(LOGERR,_("Temperature adjustment failed."));
-		exiting = 1;
+		if( transition_active(trans) )
+			(void)transition_sleep_until(transition_next_deadline(trans));
 	}
+	return RET_FUN_SUCCESS;
 }
 
 /* Change gamma continuously until break signal. */
 static int _do_console(void)
 {
+	transition_s trans;
+	systemtime_watch_s watch;
 	int target_temp;
 	int transpeed = opt_get_trans_speed();
-	int sec_countdown=0;
-	int saved_temp = gamma_state_get_temperature();
-	int curr_temp = saved_temp;
+	unsigned long wakeups = 0;
+	double started = 0.0;
+	double now = 0.0;
+	double deadline;
+	double jump;
+	double wall;
+	double next;
 
-	LOG(LOGVERBOSE,_("Original temp: %dK"),saved_temp);
+	transition_init(&trans,gamma_state_get_temperature());
+	LOG(LOGVERBOSE,_("Original temp: %dK"),trans.curr);
 	sig_register();
+	(void)transition_now(&started);
+	(void)systemtime_watch_init(&watch);
 	do{
-		// Re-check every 20 minutes
-		if( sec_countdown <= 0 ){
-			curr_temp=gamma_state_get_temperature();
-			target_temp=gamma_calc_curr_target_temp(
-				opt_get_lat(),opt_get_lon(),
-				opt_get_temp_day(),opt_get_temp_night());
-			transition_to_temp(curr_temp,target_temp,transpeed);
-			sec_countdown = 60*20;
+		// Another program may have replaced our ramps meanwhile
+		gamma_force_refresh();
+		if( !transition_active(&trans) )
+			transition_init(&trans,gamma_state_get_temperature());
+		target_temp=gamma_calc_curr_target_temp(
+			opt_get_lat(),opt_get_lon(),
+			opt_get_temp_day(),opt_get_temp_night());
+		if( trans.curr==target_temp ){
+			if( !gamma_state_set_temperature(target_temp,opt_get_gamma()) )
+				LOG(LOGERR,_("Temperature adjustment failed."));
+		}else if( transition_now(&now) ){
+			transition_set_target(&trans,target_temp,transpeed,now);
+			if( !transition_run(&trans) )
+				exiting = 1;
+		}
+		if( exiting )
+			break;
+		// Sleep until the target moves by a noticeable step
+		if( systemtime_get_time(&wall) && transition_now(&now) ){
+			next = gamma_calc_next_change(opt_get_lat(),opt_get_lon(),
+				opt_get_temp_day(),opt_get_temp_night(),wall,
+				TRANSITION_JND,CONSOLE_MAX_SLEEP);
+			LOG(LOGVERBOSE,_("Sleeping %.0fs until the next temperature change"),
+					next-wall);
+			// No clock events here, check for jumps now and then
+			deadline = now+(next-wall);
+			do{
+				console_sleep_until(MIN(deadline,now+SYSTEMTIME_WATCH_PERIOD));
+				++wakeups;
+				if( systemtime_watch_check(&watch,&jump) ){
+					LOG(LOGINFO,_("System time jumped by %.0fs"),jump);
+					break;
+				}
+			}while( !exiting && transition_now(&now) && (now<deadline) );
 		}else{
-			--sec_countdown;
+			SLEEP(1000);
+			++wakeups;
 		}
-		LOG(LOGVERBOSE,_("Countdown: %d"),sec_countdown);
-		SLEEP(1000);
 	}while(!exiting);
+	if( transition_now(&now) && (now>started) )
+		LOG(LOGINFO,_("Console woke up %lu times in %.2fh (%.1f per hour)"),
+				wakeups,(now-started)/3600.0,wakeups*3600.0/(now-started));
 	exiting=0;
-	curr_temp=gamma_state_get_temperature();
-	// Use a constant 2000K/s transition speed to exit
-	transition_to_temp(curr_temp,DEFAULT_DAY_TEMP,2000);
+	if( !transition_active(&trans) )
+		transition_init(&trans,gamma_state_get_temperature());
+	// Use a constant 2000K/s transition speed to exit, an interrupted
+	// transition turns around from where it is
+	if( transition_now(&now) ){
+		transition_set_target(&trans,DEFAULT_DAY_TEMP,2000,now);
+		(void)transition_run(&trans);
+	}
+	// Interrupted again or paused, jump straight to the target; unchanged
+	// ramps are skipped by the backend
+	if( !gamma_state_write_temperature(DEFAULT_DAY_TEMP,opt_get_gamma()) ){
+		LOG(LOGERR,_("Temperature adjustment failed."));
+		return RET_FUN_FAILED;
+	}
 	return RET_FUN_SUCCESS;
 }
+#endif /* ! HAVE_EVLOOP */
 
 int main(int argc, char *argv[]){
 	gamma_method_t method;
+	transition_stats_s trans_stats;
 	int ret=RET_MAIN_ERR;
+#ifdef HAVE_EVLOOP
+	char *cmd;
+	char *val;
+#endif
 
 #ifdef _WIN32
 	// This attaches a console to the parent process if it has a console
@@ -296,9 +829,27 @@ int main(int argc, char *argv[]){
 	if( !(_parse_options(argc,argv)) )
 		goto end;
 
+#ifdef HAVE_EVLOOP
+	// Client of the running daemon, nothing else to initialize
+	if( (cmd=args_getnamed("ctl")) ){
+		ret = control_send(cmd);
+		goto end;
+	}
+	// Before anything logs to the standard output it takes over
+	if( opt_get_nogui() && !opt_get_oneshot()
+			&& (cmd=args_getnamed("follow"))
+			&& !follow_init(cmd,args_getnamed("followto"),
+				(val=args_getnamed("followhz")) ? atof(val)
+				: FOLLOW_DEFAULT_RATE) )
+		goto end;
+#endif
+
 	// Initialize gamma method
 	if( !gamma_load_methods() )
 		goto end;
+	gamma_cache_set_limit((size_t)opt_get_cache_size()*1024);
+	if( (opt_get_wptable()[0]!='\0') && !wptable_load(opt_get_wptable()) )
+		LOG(LOGWARN,_("Using built-in white point table"));
 
 	method = gamma_init_method(opt_get_screen(),opt_get_crtc(),
 			opt_get_method());
@@ -318,6 +869,10 @@ int main(int argc, char *argv[]){
 	}else if(opt_get_nogui()){
 		// Console mode
 		LOG(LOGVERBOSE,_("Starting in console mode."));
+#ifdef HAVE_EVLOOP
+		console_argc = argc;
+		console_argv = argv;
+#endif
 		ret = _do_console();
 	}else{
 		// GUI mode
@@ -332,9 +887,20 @@ int main(int argc, char *argv[]){
 #endif
 	}
 	(void)net_end();
+	transition_get_stats(&trans_stats);
+	if( trans_stats.commits>0 )
+		LOG(LOGINFO,_("Transition commits: %lu, %.1fms average, %.1fms max,"
+					" %lu steps dropped"),trans_stats.commits,
+				trans_stats.latency_total*1000.0/trans_stats.commits,
+				trans_stats.latency_max*1000.0,trans_stats.dropped);
 	(void)gamma_state_free();
+	gamma_pool_clear();
+	wptable_free();
 
 	end:
+#ifdef HAVE_EVLOOP
+	follow_end();
+#endif
 	opt_free();
 	args_free();
 	log_end();
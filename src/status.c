@@ -0,0 +1,209 @@
+#include "common.h"
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "status.h"
+
+/**\brief Writer state */
+typedef struct{
+	/**\brief Segment file, -1 if not publishing */
+	int fd;
+	/**\brief Mapped segment */
+	/*@null@*/ status_s *shm;
+} status_writer_s;
+
+static status_writer_s writer = {-1,NULL};
+
+/* Retrieves the segment path */
+int status_get_path(char buffer[], size_t bufsize){
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+	int len;
+
+	// A shared directory like /tmp lets others plant the file first
+	if( (dir==NULL) || (dir[0]=='\0') ){
+		LOG(LOGERR,_("XDG_RUNTIME_DIR is not set"));
+		return RET_FUN_FAILED;
+	}
+	len = snprintf(buffer,bufsize,"%s/redshiftgui.status",dir);
+	if( (len<0) || ((size_t)len>=bufsize) ){
+		LOG(LOGERR,_("Status segment path too long"));
+		return RET_FUN_FAILED;
+	}
+	return RET_FUN_SUCCESS;
+}
+
+// Only a plain file of ours, not a link to or of someone else's
+static int status_check(int fd, const char *path, size_t size){
+	struct stat st;
+
+	if( (fstat(fd,&st)!=0) || !S_ISREG(st.st_mode)
+			|| (st.st_uid!=getuid()) || (st.st_nlink!=1)
+			|| (st.st_size<(off_t)size) ){
+		LOG(LOGERR,_("%s is not a status segment"),path);
+		return RET_FUN_FAILED;
+	}
+	return RET_FUN_SUCCESS;
+}
+
+// Starts a write, seq turns odd
+static void status_write_begin(status_s *shm){
+	((volatile status_s*)shm)->seq = shm->seq+1;
+	__sync_synchronize();
+}
+
+// Ends a write, seq turns even
+static void status_write_end(status_s *shm){
+	__sync_synchronize();
+	((volatile status_s*)shm)->seq = shm->seq+1;
+}
+
+/* Creates or reuses the segment */
+int status_init(void){
+	char path[LONGEST_PATH];
+	void *map;
+	int fd;
+
+	if( !status_get_path(path,sizeof(path)) )
+		return RET_FUN_FAILED;
+	// Not truncated, readers of a previous daemon keep their mapping
+	fd = open(path,O_RDWR|O_CREAT|O_NOFOLLOW|O_CLOEXEC,
+			S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
+	if( fd<0 ){
+		LOG(LOGERR,_("Unable to open %s: %s"),path,strerror(errno));
+		return RET_FUN_FAILED;
+	}
+	if( !status_check(fd,path,0) ){
+		(void)close(fd);
+		return RET_FUN_FAILED;
+	}
+	// Two writers would break the sequence lock
+	if( flock(fd,LOCK_EX|LOCK_NB)!=0 ){
+		LOG(LOGERR,_("Another instance publishes to %s"),path);
+		(void)close(fd);
+		return RET_FUN_FAILED;
+	}
+	if( (ftruncate(fd,(off_t)sizeof(status_s))!=0)
+			|| ((map=mmap(NULL,sizeof(status_s),PROT_READ|PROT_WRITE,
+					MAP_SHARED,fd,0))==MAP_FAILED) ){
+		LOG(LOGERR,_("Unable to map %s: %s"),path,strerror(errno));
+		(void)close(fd);
+		return RET_FUN_FAILED;
+	}
+	writer.fd = fd;
+	writer.shm = (status_s*)map;
+	// A writer killed mid-update left seq odd
+	if( writer.shm->seq & 1 )
+		writer.shm->seq++;
+	status_write_begin(writer.shm);
+	writer.shm->magic = STATUS_MAGIC;
+	writer.shm->version = STATUS_VERSION;
+	writer.shm->pid = (int32_t)getpid();
+	status_write_end(writer.shm);
+	LOG(LOGVERBOSE,_("Publishing status to %s"),path);
+	return RET_FUN_SUCCESS;
+}
+
+/* Marks the segment stopped */
+void status_end(void){
+	if( !writer.shm )
+		return;
+	status_write_begin(writer.shm);
+	writer.shm->mode = STATUS_MODE_STOPPED;
+	writer.shm->pid = 0;
+	status_write_end(writer.shm);
+	(void)munmap(writer.shm,sizeof(status_s));
+	(void)close(writer.fd);
+	writer.shm = NULL;
+	writer.fd = -1;
+}
+
+/* Publishes a new state */
+void status_publish(const status_s *state){
+	status_s *shm = writer.shm;
+
+	if( !shm )
+		return;
+	status_write_begin(shm);
+	shm->updated = state->updated;
+	shm->suppressed = state->suppressed;
+	shm->temp = state->temp;
+	shm->target = state->target;
+	shm->mode = state->mode;
+	shm->paused = state->paused;
+	shm->brightness = state->brightness;
+	shm->elevation = state->elevation;
+	status_write_end(shm);
+}
+
+/* Maps the segment read only */
+const status_s *status_open(void){
+	char path[LONGEST_PATH];
+	void *map;
+	int fd;
+
+	if( !status_get_path(path,sizeof(path)) )
+		return NULL;
+	fd = open(path,O_RDONLY|O_NOFOLLOW|O_CLOEXEC);
+	if( fd<0 ){
+		LOG(LOGERR,_("Unable to open %s: %s"),path,strerror(errno));
+		return NULL;
+	}
+	if( !status_check(fd,path,sizeof(status_s)) ){
+		(void)close(fd);
+		return NULL;
+	}
+	map = mmap(NULL,sizeof(status_s),PROT_READ,MAP_SHARED,fd,0);
+	// The mapping stays valid without the descriptor
+	(void)close(fd);
+	if( map==MAP_FAILED ){
+		LOG(LOGERR,_("Unable to map %s: %s"),path,strerror(errno));
+		return NULL;
+	}
+	return (const status_s*)map;
+}
+
+/* Unmaps a segment */
+void status_close(const status_s *shm){
+	(void)munmap((void*)shm,sizeof(status_s));
+}
+
+/* Copies a consistent snapshot */
+int status_read(const status_s *shm, status_s *snap){
+	const volatile status_s *vshm = shm;
+	uint32_t seq;
+	int tries;
+
+	for( tries=0; tries<STATUS_READ_TRIES; ++tries ){
+		seq = vshm->seq;
+		if( seq & 1 ){
+			// Let a preempted writer finish on a single CPU
+			if( (tries % STATUS_READ_SPINS)==STATUS_READ_SPINS-1 )
+				(void)sched_yield();
+			continue;
+		}
+		__sync_synchronize();
+		memcpy(snap,shm,sizeof(*snap));
+		__sync_synchronize();
+		if( vshm->seq==seq ){
+			snap->seq = seq;
+			return (snap->magic==STATUS_MAGIC)
+				&& (snap->version>=STATUS_VERSION);
+		}
+	}
+	return RET_FUN_FAILED;
+}
+
+/* Name of a mode */
+const char *status_mode_name(int mode){
+	static const char *names[] = {"auto","manual","hold","exiting","stopped"};
+
+	if( (mode<STATUS_MODE_AUTO) || (mode>STATUS_MODE_STOPPED) )
+		return "unknown";
+	return names[mode];
+}
+
+#endif /* ! _WIN32 */
@@ -0,0 +1,109 @@
+/**\file		status.h
+ * \brief		Status segment shared with status bars and monitors.
+ * \details
+ * The console daemon publishes its state into a small file mapped in
+ * memory, $XDG_RUNTIME_DIR/redshiftgui.status, so readers only
+ * map it once and then read it without any system call.  Writes are
+ * guarded by a sequence lock: the writer makes seq odd, updates the fields
+ * and makes it even again, and a reader retries until it copied the
+ * fields with the same even seq before and after.  Any number of readers
+ * can poll it without ever blocking the daemon.
+ *
+ * The file outlives the daemon with mode STATUS_MODE_STOPPED and the next
+ * daemon reuses it, so a reader mapping it keeps working across restarts.
+ * The layout only grows at the end, with version bumped.  There is no
+ * fallback to /tmp without XDG_RUNTIME_DIR, and a symbolic link, hard link
+ * or file of another user is refused.  See
+ * tools/rsgstatus.c for a reader.
+ */
+
+#ifndef __STATUS_H__
+#define __STATUS_H__
+#ifndef _WIN32
+
+/**\brief First field of a valid segment ("RSGS") */
+#define STATUS_MAGIC	0x53475352u
+/**\brief Layout version */
+#define STATUS_VERSION	1
+/**\brief Attempts of status_read() while the writer is busy */
+#define STATUS_READ_TRIES	100000
+/**\brief Busy attempts of status_read() before yielding the CPU */
+#define STATUS_READ_SPINS	64
+
+/**\brief Following the sun */
+#define STATUS_MODE_AUTO	0
+/**\brief Temperature set with the temp command */
+#define STATUS_MODE_MANUAL	1
+/**\brief Changes held with the pause command */
+#define STATUS_MODE_HOLD	2
+/**\brief Restoring the ramps before exiting */
+#define STATUS_MODE_EXITING	3
+/**\brief No daemon running */
+#define STATUS_MODE_STOPPED	4
+
+/**\brief Status segment layout */
+typedef struct{
+	/**\brief STATUS_MAGIC */
+	uint32_t magic;
+	/**\brief STATUS_VERSION */
+	uint32_t version;
+	/**\brief Sequence lock, odd while the writer updates the fields */
+	uint32_t seq;
+	/**\brief Process ID of the daemon */
+	int32_t pid;
+	/**\brief System time of the last update */
+	double updated;
+	/**\brief Ramp writes skipped while paused */
+	uint64_t suppressed;
+	/**\brief Temperature on screen in K */
+	int32_t temp;
+	/**\brief Temperature the daemon heads for in K */
+	int32_t target;
+	/**\brief STATUS_MODE_* */
+	int32_t mode;
+	/**\brief GAMMA_PAUSE_* reasons in effect, 0 if writing ramps */
+	int32_t paused;
+	/**\brief Brightness (0.1 - 1) */
+	float brightness;
+	/**\brief Solar elevation in degrees */
+	float elevation;
+} status_s;
+
+/**\brief Retrieves the segment path
+ * \return RET_FUN_FAILED without XDG_RUNTIME_DIR or if it does not fit in
+ * buffer
+ */
+int status_get_path(/*@out@*/ char buffer[], size_t bufsize);
+
+/**\brief Creates or reuses the segment for writing
+ * \details Fails if another daemon holds it.
+ */
+int status_init(void);
+
+/**\brief Marks the segment stopped and unmaps it */
+void status_end(void);
+
+/**\brief Publishes a new state
+ * \param state fields from updated on, the header is ignored
+ */
+void status_publish(const status_s *state);
+
+/**\brief Maps the segment read only
+ * \return NULL if no daemon ever created it
+ */
+/*@null@*/ const status_s *status_open(void);
+
+/**\brief Unmaps a segment from status_open() */
+void status_close(/*@only@*/ const status_s *shm);
+
+/**\brief Copies a consistent snapshot of the segment
+ * \return RET_FUN_FAILED if the segment is invalid or the writer stayed
+ * busy for STATUS_READ_TRIES attempts
+ */
+int status_read(const status_s *shm, /*@out@*/ status_s *snap);
+
+/**\brief Name of a STATUS_MODE_* value */
+const char *status_mode_name(int mode);
+
+#endif /* ! _WIN32 */
+#endif//__STATUS_H__
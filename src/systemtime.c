@@ -19,6 +19,16 @@
 
 #include "common.h"
 #include "systemtime.h"
+#ifndef _WIN32
+# include <errno.h>
+#endif
+
+/* Added to the system time, moves it without touching the real clock */
+static double skew = 0.0;
+
+void systemtime_set_skew(double seconds){
+	skew = seconds;
+}
 
 int systemtime_get_time(double *t){
 #ifndef _WIN32
@@ -41,6 +51,91 @@ int systemtime_get_time(double *t){
 	/* FILETIME is tenths of microseconds since 1601-01-01 UTC */
 	/*@i@*/*t = (i.QuadPart / 10000000.0) - 11644473600.0;
 #endif /* _WIN32 */
+	*t += skew;
+
+	return RET_FUN_SUCCESS;
+}
+
+int systemtime_get_monotonic(double *t){
+#ifndef _WIN32
+	struct timespec now;
+	/*@i@*/int r = clock_gettime(CLOCK_MONOTONIC, &now);
+	if (r < 0) {
+		*t=0.0;
+		perror("clock_gettime");
+		return RET_FUN_FAILED;
+	}
+
+	/*@i@*/*t = now.tv_sec + (now.tv_nsec / 1000000000.0);
+#else /* _WIN32 */
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER now;
+	if( (freq.QuadPart==0) && !QueryPerformanceFrequency(&freq) ){
+		*t=0.0;
+		return RET_FUN_FAILED;
+	}
+	(void)QueryPerformanceCounter(&now);
+	/*@i@*/*t = (double)now.QuadPart/(double)freq.QuadPart;
+#endif /* _WIN32 */
 
 	return RET_FUN_SUCCESS;
 }
+
+int systemtime_sleep_until(double deadline){
+#ifndef _WIN32
+	struct timespec ts;
+	int r;
+	if( deadline<0.0 )
+		deadline=0.0;
+	/*@i@*/ts.tv_sec = (time_t)deadline;
+	/*@i@*/ts.tv_nsec = (long)((deadline-(double)ts.tv_sec)*1000000000.0);
+	if( ts.tv_nsec>999999999L )
+		ts.tv_nsec = 999999999L;
+	/*@i@*/r = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	if( r==EINTR )
+		return RET_FUN_FAILED;
+	if( r!=0 ){
+		errno = r;
+		perror("clock_nanosleep");
+		return RET_FUN_FAILED;
+	}
+#else /* _WIN32 */
+	double now;
+	if( !systemtime_get_monotonic(&now) )
+		return RET_FUN_FAILED;
+	if( deadline>now )
+		Sleep((DWORD)((deadline-now)*1000.0+0.5));
+#endif /* _WIN32 */
+
+	return RET_FUN_SUCCESS;
+}
+
+// Reads the system time relative to the monotonic clock
+static int systemtime_get_offset(/*@out@*/ double *offset){
+	double wall;
+	double mono;
+	if( !systemtime_get_time(&wall) || !systemtime_get_monotonic(&mono) ){
+		*offset=0.0;
+		return RET_FUN_FAILED;
+	}
+	*offset = wall-mono;
+	return RET_FUN_SUCCESS;
+}
+
+int systemtime_watch_init(systemtime_watch_s *watch){
+	return systemtime_get_offset(&watch->offset);
+}
+
+int systemtime_watch_check(systemtime_watch_s *watch, double *jump){
+	double offset;
+	*jump = 0.0;
+	if( !systemtime_get_offset(&offset) )
+		return 0;
+	// Follow slow NTP adjustments, they never add up between checks
+	*jump = offset-watch->offset;
+	watch->offset = offset;
+	if( fabs(*jump)>SYSTEMTIME_JUMP )
+		return 1;
+	*jump = 0.0;
+	return 0;
+}
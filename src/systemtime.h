@@ -7,7 +7,49 @@
 #ifndef _REDSHIFT_SYSTEMTIME_H
 #define _REDSHIFT_SYSTEMTIME_H
 
+/**\brief Shifts the system time by seconds
+ * \details Only the value read by systemtime_get_time() moves, the
+ * system clock is untouched.  Lets tests jump the clock.
+ */
+void systemtime_set_skew(double seconds);
+
 /**\brief Retrieves system time for solar elevation calculation */
 int systemtime_get_time(/*@out@*/ double *now);
 
+/**\brief Retrieves seconds from a monotonic clock
+ * \details Unaffected by changes of the system time, use for deadlines.
+ */
+int systemtime_get_monotonic(/*@out@*/ double *now);
+
+/**\brief Sleeps until a monotonic clock deadline
+ * \param deadline absolute time from systemtime_get_monotonic()
+ * \return RET_FUN_FAILED if interrupted by a signal or on error
+ */
+int systemtime_sleep_until(double deadline);
+
+/**\brief Offset change in seconds reported as a clock jump */
+#define SYSTEMTIME_JUMP 2.0
+/**\brief Period in seconds of clock checks when no clock event is available */
+#define SYSTEMTIME_WATCH_PERIOD 60
+
+/**\brief Clock jump detector
+ * \details The system time moves against the monotonic clock only when it
+ * is set (manually or by NTP) and, on Linux, while the machine is
+ * suspended, since the monotonic clock stops then.
+ */
+typedef struct{
+	/**\brief System time minus monotonic time at the last check */
+	double offset;
+} systemtime_watch_s;
+
+/**\brief Starts watching for clock jumps */
+int systemtime_watch_init(/*@out@*/ systemtime_watch_s *watch);
+
+/**\brief Checks whether the clocks jumped since the last check
+ * \param watch detector
+ * \param jump receives the jump in seconds, 0 if none
+ * \return 1 if the system time jumped by more than SYSTEMTIME_JUMP
+ */
+int systemtime_watch_check(systemtime_watch_s *watch, /*@out@*/ double *jump);
+
 #endif /* ! _REDSHIFT_SYSTEMTIME_H */
@@ -0,0 +1,45 @@
+/**\file		test.h
+ * \brief		Checks shared by the unit tests.
+ * \details
+ * Each test is a small program run by ctest.  A failed TEST_CHECK() prints
+ * where it failed and carries on, TEST_END() makes the exit status fail if
+ * any check did.  Log messages are limited to warnings so that the output
+ * only shows what went wrong.
+ */
+
+#ifndef __TEST_H__
+#define __TEST_H__
+
+/**\brief Number of failed checks */
+static int test_failed = 0;
+
+/**\brief Checks a condition, printing it if false */
+#define TEST_CHECK(cond) do{ \
+		if( !(cond) ){ \
+			printf("%s:%d: check failed: %s\n",__FILE__,__LINE__,#cond); \
+			++test_failed; \
+		} \
+	}while(0)
+
+/**\brief Checks a condition, printing it with a message if false */
+#define TEST_CHECKF(cond,...) do{ \
+		if( !(cond) ){ \
+			printf("%s:%d: check failed: %s: ",__FILE__,__LINE__,#cond); \
+			printf(__VA_ARGS__); \
+			printf("\n"); \
+			++test_failed; \
+		} \
+	}while(0)
+
+/**\brief Starts a test program */
+#define TEST_BEGIN() do{ \
+		if( log_init(NULL,LOGBOOL_FALSE,NULL)!=LOGRET_OK ) \
+			return 1; \
+		(void)log_setlevel(LOGWARN); \
+	}while(0)
+
+/**\brief Ends a test program, use as return value of main */
+#define TEST_END() (log_end(), printf("%s\n",test_failed ? "FAILED" : "OK"), \
+		test_failed ? 1 : 0)
+
+#endif//__TEST_H__
@@ -0,0 +1,266 @@
+/**\file		test_evloop.c
+ * \brief		Event loop tests.
+ * \details
+ * Feeds the deadline timer, the signalfd, sockets and clock jumps through
+ * evloop_dispatch().  Clock jumps are made with systemtime_set_skew(), the
+ * system clock is not touched.
+ */
+
+#include "../common.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include "../systemtime.h"
+#include "../evloop.h"
+#include "test.h"
+
+/* Longest wait for an event that is due, generous for loaded machines */
+#define WAIT_MS 2000
+/* Lateness accepted of a deadline */
+#define LATE_MAX 0.25
+
+/* What the handlers saw */
+typedef struct{
+	int timers;
+	double fired;
+	int signals;
+	int signo;
+	int clocks;
+	double jump;
+	int reads;
+	int errs;
+	int calls[2];
+	int fds[2];
+} seen_s;
+
+static seen_s seen;
+/* Makes the next epoll_create1() fail */
+static int fail_epoll = 0;
+
+/* Stand-in for the libc call, the loop's first descriptor */
+int epoll_create1(int flags){
+	if( fail_epoll ){
+		fail_epoll = 0;
+		errno = EMFILE;
+		return -1;
+	}
+	return (int)syscall(SYS_epoll_create1,flags);
+}
+
+static void on_timer(void *data){
+	(void)data;
+	++seen.timers;
+	(void)systemtime_get_monotonic(&seen.fired);
+}
+
+static void on_signal(int signo, void *data){
+	(void)data;
+	++seen.signals;
+	seen.signo = signo;
+}
+
+static void on_clock(double jump, void *data){
+	(void)data;
+	++seen.clocks;
+	seen.jump = jump;
+}
+
+// Drains a socket and notes what it reported
+static void on_socket(int fd, int events, void *data){
+	char buf[64];
+
+	(void)data;
+	if( events & EVLOOP_IN ){
+		++seen.reads;
+		while( recv(fd,buf,sizeof(buf),MSG_DONTWAIT)>0 );
+	}
+	if( events & EVLOOP_ERR ){
+		++seen.errs;
+		(void)evloop_remove(fd);
+	}
+}
+
+// Each removes the other, only the first of a batch may run
+static void on_pair(int fd, int events, void *data){
+	int i = (fd==seen.fds[0]) ? 0 : 1;
+
+	(void)events;
+	(void)data;
+	++seen.calls[i];
+	(void)evloop_remove(seen.fds[1-i]);
+}
+
+// Dispatches until count becomes nonzero or WAIT_MS passes
+static void wait_for(const int *count){
+	double start;
+	double now;
+
+	(void)systemtime_get_monotonic(&start);
+	now = start;
+	while( (*count==0) && (now-start<WAIT_MS/1000.0) ){
+		(void)evloop_dispatch(WAIT_MS);
+		(void)systemtime_get_monotonic(&now);
+	}
+}
+
+static void test_deadline(void){
+	double now;
+	double deadline;
+
+	memset(&seen,0,sizeof(seen));
+	(void)systemtime_get_monotonic(&now);
+	deadline = now+0.05;
+	TEST_CHECK(evloop_set_deadline(deadline));
+	wait_for(&seen.timers);
+	TEST_CHECK(seen.timers==1);
+	TEST_CHECKF(seen.fired>=deadline,"fired %.4fs early",deadline-seen.fired);
+	TEST_CHECKF(seen.fired<deadline+LATE_MAX,"fired %.4fs late",
+			seen.fired-deadline);
+
+	// A deadline already passed expires on the next wait
+	memset(&seen,0,sizeof(seen));
+	TEST_CHECK(evloop_set_deadline(now-10.0));
+	wait_for(&seen.timers);
+	TEST_CHECK(seen.timers==1);
+
+	// Disarmed, and a moved deadline fires only once
+	memset(&seen,0,sizeof(seen));
+	(void)systemtime_get_monotonic(&now);
+	TEST_CHECK(evloop_set_deadline(now+0.02));
+	TEST_CHECK(evloop_set_deadline(-1.0));
+	TEST_CHECK(evloop_dispatch(100)==0);
+	TEST_CHECK(seen.timers==0);
+	TEST_CHECK(evloop_set_deadline(now+0.02));
+	TEST_CHECK(evloop_set_deadline(now+0.04));
+	wait_for(&seen.timers);
+	TEST_CHECK(evloop_dispatch(100)==0);
+	TEST_CHECK(seen.timers==1);
+}
+
+// Lowest free descriptor
+static int lowest_fd(void){
+	int fd = open("/dev/null",O_RDONLY);
+
+	if( fd>=0 )
+		(void)close(fd);
+	return fd;
+}
+
+static void test_init_fail(void){
+	sigset_t mask;
+	int fd = lowest_fd();
+
+	// The timerfd and signalfd are made, then released with the mask
+	fail_epoll = 1;
+	TEST_CHECK(!evloop_init(&on_timer,&on_signal,&on_clock,NULL));
+	TEST_CHECK(!fail_epoll);
+	TEST_CHECKF(lowest_fd()==fd,"descriptor %d left open",fd);
+	TEST_CHECK(sigprocmask(SIG_BLOCK,NULL,&mask)==0);
+	TEST_CHECK(!sigismember(&mask,SIGHUP));
+	evloop_end();
+}
+
+static void test_signal(void){
+	evloop_stats_s stats;
+	unsigned long before;
+
+	memset(&seen,0,sizeof(seen));
+	evloop_get_stats(&stats);
+	before = stats.signals;
+	// Blocked by the loop, it waits in the signalfd
+	TEST_CHECK(raise(SIGHUP)==0);
+	wait_for(&seen.signals);
+	TEST_CHECK(seen.signals==1);
+	TEST_CHECK(seen.signo==SIGHUP);
+	evloop_get_stats(&stats);
+	TEST_CHECK(stats.signals==before+1);
+	TEST_CHECK(seen.timers==0);
+}
+
+static void test_socket(void){
+	int sv[2];
+	int pa[2];
+	int pb[2];
+
+	memset(&seen,0,sizeof(seen));
+	TEST_CHECK(socketpair(AF_UNIX,SOCK_STREAM,0,sv)==0);
+	TEST_CHECK(evloop_add(sv[0],&on_socket,NULL));
+	TEST_CHECK(evloop_dispatch(50)==0);
+	TEST_CHECK(write(sv[1],"ping",4)==4);
+	wait_for(&seen.reads);
+	TEST_CHECK(seen.reads==1);
+	TEST_CHECK(seen.errs==0);
+	// Hang up is an error event, the handler removes the socket
+	(void)close(sv[1]);
+	wait_for(&seen.errs);
+	TEST_CHECK(seen.errs==1);
+	TEST_CHECK(evloop_remove(sv[0])==RET_FUN_FAILED);
+	(void)close(sv[0]);
+
+	// Events of a source removed earlier in the same batch are dropped
+	TEST_CHECK(socketpair(AF_UNIX,SOCK_STREAM,0,pa)==0);
+	TEST_CHECK(socketpair(AF_UNIX,SOCK_STREAM,0,pb)==0);
+	seen.fds[0] = pa[0];
+	seen.fds[1] = pb[0];
+	TEST_CHECK(evloop_add(pa[0],&on_pair,NULL));
+	TEST_CHECK(evloop_add(pb[0],&on_pair,NULL));
+	TEST_CHECK(write(pa[1],"a",1)==1);
+	TEST_CHECK(write(pb[1],"b",1)==1);
+	TEST_CHECK(evloop_dispatch(WAIT_MS)==2);
+	TEST_CHECKF(seen.calls[0]+seen.calls[1]==1,"%d and %d calls",
+			seen.calls[0],seen.calls[1]);
+	(void)evloop_remove(pa[0]);
+	(void)evloop_remove(pb[0]);
+	(void)close(pa[0]);
+	(void)close(pa[1]);
+	(void)close(pb[0]);
+	(void)close(pb[1]);
+}
+
+static void test_clock(void){
+	double now;
+
+	// Jumps are reported once, after the events of the wakeup
+	memset(&seen,0,sizeof(seen));
+	systemtime_set_skew(3600.0);
+	(void)systemtime_get_monotonic(&now);
+	TEST_CHECK(evloop_set_deadline(now));
+	wait_for(&seen.timers);
+	TEST_CHECK(seen.timers==1);
+	TEST_CHECK(seen.clocks==1);
+	TEST_CHECKF(fabs(seen.jump-3600.0)<1.0,"jump %.3fs",seen.jump);
+
+	memset(&seen,0,sizeof(seen));
+	systemtime_set_skew(0.0);
+	TEST_CHECK(evloop_set_deadline(now));
+	wait_for(&seen.timers);
+	TEST_CHECK(seen.clocks==1);
+	TEST_CHECKF(fabs(seen.jump+3600.0)<1.0,"jump %.3fs",seen.jump);
+
+	// NTP sized adjustments are not jumps
+	memset(&seen,0,sizeof(seen));
+	systemtime_set_skew(SYSTEMTIME_JUMP/2.0);
+	TEST_CHECK(evloop_set_deadline(now));
+	wait_for(&seen.timers);
+	TEST_CHECK(seen.timers==1);
+	TEST_CHECK(seen.clocks==0);
+	systemtime_set_skew(0.0);
+}
+
+int main(void){
+	TEST_BEGIN();
+	test_init_fail();
+	if( !evloop_init(&on_timer,&on_signal,&on_clock,NULL) ){
+		printf("Unable to create the event loop\n");
+		return 1;
+	}
+	test_deadline();
+	test_signal();
+	test_socket();
+	test_clock();
+	evloop_end();
+	return TEST_END();
+}
@@ -0,0 +1,195 @@
+/**\file		test_pause.c
+ * \brief		Paused ramp writes tests.
+ * \details
+ * A fake backend stands in for RANDR.  Like the real one it fills a ramp
+ * for each request and skips writes gamma_commit_needed() finds
+ * redundant, so the tests see what would reach the display.  Its event
+ * handler delivers pause changes queued by the test, the way X events
+ * arrive from within gamma_state_set_temperature().
+ */
+
+#include "../common.h"
+#include "../gamma.h"
+#include "../options.h"
+#include "test.h"
+
+/* Ramp size of the fake output */
+#define RAMP_SIZE 256
+
+/* Fake output */
+static struct{
+	gamma_ramp_s ramp;
+	gamma_commit_s commit;
+	/* Ramps written */
+	int writes;
+	/* Temperature of the last ramp written */
+	int temp;
+	/* Pause change delivered on the next event check, 0 if none */
+	int reason;
+	int on;
+} out;
+
+static int fake_init(int screen_num, int crtc_num){
+	(void)screen_num;
+	(void)crtc_num;
+	out.ramp = gamma_pool_get(RAMP_SIZE);
+	memset(&out.commit,0,sizeof(out.commit));
+	return (out.ramp.all!=NULL);
+}
+
+static int fake_end(void){
+	gamma_pool_put(&out.ramp);
+	return RET_FUN_SUCCESS;
+}
+
+static int fake_set_temp(int temp, gamma_s gamma){
+	(void)gamma;
+	if( !gamma_ramp_fill(&out.ramp,temp) )
+		return RET_FUN_FAILED;
+	if( gamma_commit_needed(&out.commit,&out.ramp) ){
+		++out.writes;
+		out.temp = temp;
+		gamma_commit_done(&out.commit);
+	}
+	return RET_FUN_SUCCESS;
+}
+
+static int fake_get_temp(void){
+	return out.temp;
+}
+
+static int fake_handle_events(void){
+	if( out.reason ){
+		gamma_state_pause(out.reason,out.on);
+		out.reason = 0;
+	}
+	return RET_FUN_SUCCESS;
+}
+
+#ifdef ENABLE_RANDR
+int randr_load_funcs(gamma_method_s *method){
+	method->func_init = &fake_init;
+	method->func_end = &fake_end;
+	method->func_set_temp = &fake_set_temp;
+	method->func_get_temp = &fake_get_temp;
+	method->func_handle_events = &fake_handle_events;
+	method->name = "Fake";
+	return RET_FUN_SUCCESS;
+}
+#endif
+#ifdef ENABLE_VIDMODE
+int vidmode_load_funcs(gamma_method_s *method){
+	(void)method;
+	return RET_FUN_SUCCESS;
+}
+#endif
+
+static const gamma_s neutral = {1.0f,1.0f,1.0f};
+
+// Sets a temperature and checks the writes it caused
+static void check_set(int temp, int writes, int shown){
+	out.writes = 0;
+	TEST_CHECK(gamma_state_set_temperature(temp,neutral));
+	TEST_CHECKF(out.writes==writes,"%dK: %d writes, not %d",temp,out.writes,
+			writes);
+	TEST_CHECKF(out.temp==shown,"%dK: %dK shown, not %dK",temp,out.temp,shown);
+}
+
+// Pauses or resumes and checks the writes it caused
+static void check_pause(int reason, int on, int writes){
+	out.writes = 0;
+	gamma_state_pause(reason,on);
+	TEST_CHECKF(out.writes==writes,"%s %d: %d writes, not %d",
+			(reason==GAMMA_PAUSE_BLANKED) ? "blanked" : "fullscreen",on,
+			out.writes,writes);
+}
+
+// Exits the way the console does, paused for reason, and checks the day
+// ramps reach the display
+static void check_exit(int reason){
+	check_set(4000,1,4000);
+	check_pause(reason,1,0);
+	check_set(3700,0,4000);
+	out.writes = 0;
+	TEST_CHECK(gamma_state_write_temperature(DEFAULT_DAY_TEMP,neutral));
+	TEST_CHECKF(out.writes==1,"exit write while paused: %d writes, not 1",
+			out.writes);
+	TEST_CHECKF(out.temp==DEFAULT_DAY_TEMP,"%dK shown after exit, not %dK",
+			out.temp,DEFAULT_DAY_TEMP);
+	// Still paused, but nothing left to hold back
+	check_pause(reason,0,1);
+	TEST_CHECK(out.temp==DEFAULT_DAY_TEMP);
+}
+
+int main(void){
+	static const int reasons[] = {GAMMA_PAUSE_BLANKED,GAMMA_PAUSE_FULLSCREEN};
+	int i;
+
+	TEST_BEGIN();
+	opt_init();
+	if( !gamma_load_methods()
+			|| (gamma_init_method(-1,-1,GAMMA_METHOD_RANDR)!=GAMMA_METHOD_RANDR) ){
+		printf("Unable to load the fake backend\n");
+		return 1;
+	}
+	check_set(5000,1,5000);
+	// The backend skips unchanged ramps
+	check_set(5000,0,5000);
+
+	for( i=0; i<2; ++i ){
+		// Nothing requested while paused, the ramps are written anyway
+		check_pause(reasons[i],1,0);
+		check_pause(reasons[i],0,1);
+		TEST_CHECK(out.temp==5000);
+		// Requests while paused only show once resumed
+		check_pause(reasons[i],1,0);
+		check_set(4500,0,5000);
+		// What is on screen, not the request held back
+		TEST_CHECK(gamma_state_get_temperature()==5000);
+		check_set(4000,0,5000);
+		check_pause(reasons[i],0,1);
+		TEST_CHECK(out.temp==4000);
+		check_set(5000,1,5000);
+	}
+
+	// Both reasons have to go
+	check_pause(GAMMA_PAUSE_BLANKED,1,0);
+	check_pause(GAMMA_PAUSE_FULLSCREEN,1,0);
+	check_set(3800,0,5000);
+	check_pause(GAMMA_PAUSE_BLANKED,0,0);
+	check_pause(GAMMA_PAUSE_FULLSCREEN,0,1);
+	TEST_CHECK(out.temp==3800);
+	TEST_CHECK(gamma_state_paused()==0);
+
+	// A resume delivered while setting writes that request, once
+	for( i=0; i<2; ++i ){
+		check_pause(reasons[i],1,0);
+		check_set(3600,0,3800);
+		out.reason = reasons[i];
+		out.on = 0;
+		check_set(3500,1,3500);
+		TEST_CHECK(gamma_state_paused()==0);
+		check_set(3500,0,3500);
+		check_set(3800,1,3800);
+	}
+
+	// A pause delivered while setting holds that request back
+	out.reason = GAMMA_PAUSE_FULLSCREEN;
+	out.on = 1;
+	check_set(4200,0,3800);
+	check_pause(GAMMA_PAUSE_FULLSCREEN,0,1);
+	TEST_CHECK(out.temp==4200);
+
+	// Stopped while blanked or with a fullscreen window focused
+	check_exit(GAMMA_PAUSE_BLANKED);
+	check_exit(GAMMA_PAUSE_FULLSCREEN);
+	// Not paused, already at the day temperature: nothing to write
+	out.writes = 0;
+	TEST_CHECK(gamma_state_write_temperature(DEFAULT_DAY_TEMP,neutral));
+	TEST_CHECK(out.writes==0);
+
+	(void)gamma_state_free();
+	gamma_pool_clear();
+	opt_free();
+	return TEST_END();
+}
@@ -0,0 +1,316 @@
+/**\file		test_transition.c
+ * \brief		Transition engine tests.
+ * \details
+ * Runs transitions on a fake clock set with transition_set_clock().
+ * Commits land in a table instead of on a display, each one takes
+ * COMMIT_LATENCY of fake time, and the clock only moves when the engine
+ * sleeps or commits, so every run is exact and instant.
+ *
+ * Single transitions are checked for their duration and step spacing,
+ * storms of retargets for steps that only ever head to the target in
+ * effect, never repeat and end on the last target.
+ */
+
+#include "../common.h"
+#include "../gamma.h"
+#include "../options.h"
+#include "../transition.h"
+#include "test.h"
+
+/* Fake time a commit takes */
+#define COMMIT_LATENCY 0.002
+/* Most commits recorded per run */
+#define MAX_COMMITS 4096
+/* Rounding a temperature to whole K moves it by less than this in mireds */
+#define ROUNDING 0.1
+/* Temperature in mireds */
+#define MIRED(temp) (1e6/(temp))
+
+/* Fake clock */
+static double simtime = 0.0;
+
+/* Commits of the current run */
+static struct{
+	double time;
+	int temp;
+	/* Target set when it was committed */
+	int target;
+	/* Prebuilt at the time? */
+	int built;
+} commits[MAX_COMMITS];
+static int ncommits = 0;
+/* Target last set by the test */
+static int target_set = 0;
+
+/* Prebuilt ramps, ticks must only commit these */
+static int ladder[MAX_COMMITS];
+static int nladder = 0;
+static int ladder_built = 0;
+static int prebuild = 0;
+
+/* Retarget storm, targets set at times */
+typedef struct{
+	double time;
+	int target;
+} storm_s;
+
+static int fake_now(double *now){
+	*now = simtime;
+	return RET_FUN_SUCCESS;
+}
+
+static int fake_sleep_until(double deadline){
+	if( deadline>simtime )
+		simtime = deadline;
+	return RET_FUN_SUCCESS;
+}
+
+static const transition_clock_s fake_clock = {&fake_now,&fake_sleep_until};
+
+/* Stand-ins for the gamma and options modules */
+int gamma_state_set_temperature(int temp, gamma_s gamma){
+	int i;
+
+	(void)gamma;
+	if( ncommits<MAX_COMMITS ){
+		commits[ncommits].time = simtime;
+		commits[ncommits].temp = temp;
+		commits[ncommits].target = target_set;
+		for( i=0; (i<nladder) && (ladder[i]!=temp); ++i );
+		commits[ncommits].built = ladder_built && (i<nladder);
+		++ncommits;
+	}
+	simtime += COMMIT_LATENCY;
+	return RET_FUN_SUCCESS;
+}
+
+int gamma_state_paused(void){
+	return 0;
+}
+
+int gamma_ladder_build(const int *temps, int count){
+	nladder = MIN(count,MAX_COMMITS);
+	memcpy(ladder,temps,sizeof(int)*nladder);
+	ladder_built = 1;
+	return RET_FUN_SUCCESS;
+}
+
+// Kept for the checks after the transition
+void gamma_ladder_free(void){
+	ladder_built = 0;
+}
+
+int opt_get_trans_budget(void){
+	return DEFAULT_TRANS_BUDGET;
+}
+
+int opt_get_prebuild(void){
+	return prebuild;
+}
+
+gamma_s opt_get_gamma(void){
+	gamma_s gamma = {1.0f,1.0f,1.0f};
+	return gamma;
+}
+
+// Ticks until the transition is idle
+static void run_ticks(transition_s *trans){
+	int ticks = 0;
+
+	while( transition_active(trans) && (ticks++<MAX_COMMITS) ){
+		(void)transition_sleep_until(transition_next_deadline(trans));
+		TEST_CHECK(transition_tick(trans,simtime));
+	}
+	TEST_CHECK(!transition_active(trans));
+}
+
+// Checks one transition from from to target at speed
+static void check_transition(int from, int target, int speed, int built){
+	transition_s trans;
+	double span = fabs(MIRED(target)-MIRED(from));
+	double duration = fabs((double)(target-from))/speed;
+	// The last TRANSITION_JND of the way is skipped
+	double early = duration*TRANSITION_JND/span;
+	double rung = built ? span/ceil(span/TRANSITION_JND) : TRANSITION_JND;
+	// Most a tick can move, at the longest period before commits are timed
+	double most = MAX(2.0*TRANSITION_JND,span/duration
+			*(TRANSITION_STEP+COMMIT_LATENCY)+TRANSITION_JND);
+	double step;
+	double dir;
+	int i;
+	int j;
+
+	prebuild = built;
+	nladder = 0;
+	ncommits = 0;
+	simtime = 1000.0;
+	transition_init(&trans,from);
+	transition_set_target(&trans,target,speed,simtime);
+	run_ticks(&trans);
+
+	TEST_CHECK(ncommits>1);
+	if( ncommits<=1 )
+		return;
+	TEST_CHECK(commits[ncommits-1].temp==target);
+	TEST_CHECK(trans.curr==target);
+	TEST_CHECK(!ladder_built);
+	// Finished on time
+	TEST_CHECKF(commits[ncommits-1].time-1000.0<=duration+COMMIT_LATENCY,
+			"%d->%dK at %dK/s took %.3fs of %.3fs",from,target,speed,
+			commits[ncommits-1].time-1000.0,duration);
+	TEST_CHECKF(commits[ncommits-1].time-1000.0>=duration-early-TRANSITION_STEP,
+			"%d->%dK at %dK/s took %.3fs of %.3fs",from,target,speed,
+			commits[ncommits-1].time-1000.0,duration);
+	dir = (MIRED(target)>MIRED(from)) ? 1.0 : -1.0;
+	for( i=0; i<ncommits; ++i ){
+		// Every step noticeable, in one direction, except the last one
+		step = (MIRED(commits[i].temp)
+				-MIRED(i ? commits[i-1].temp : from))*dir;
+		TEST_CHECKF(step<=most,"%d->%dK at %dK/s: step %d of %.2f mireds",
+				from,target,speed,i,step);
+		if( i<ncommits-1 )
+			TEST_CHECKF(step>=rung-ROUNDING,
+					"%d->%dK at %dK/s: step %d of %.2f mireds",from,target,speed,
+					i,step);
+		else
+			TEST_CHECKF(step>0.0,"%d->%dK at %dK/s: last step of %.2f mireds",
+					from,target,speed,step);
+		if( built && (i<ncommits-1) ){
+			for( j=0; (j<nladder) && (ladder[j]!=commits[i].temp); ++j );
+			TEST_CHECKF(j<nladder,"%dK is not prebuilt",commits[i].temp);
+		}
+	}
+	// Slow transitions step by about TRANSITION_JND all the way
+	if( (speed<=500) && !built )
+		TEST_CHECKF(ncommits<=(int)ceil(span/TRANSITION_JND)+1,
+				"%d->%dK at %dK/s: %d commits for %.1f mireds",from,target,speed,
+				ncommits,span);
+}
+
+// Runs a storm of retargets and checks every commit against the target
+// in effect
+static void check_storm(const char *name, const storm_s *storm, int count,
+		int from, int speed, int built, unsigned long ladders){
+	transition_s trans;
+	double prev;
+	double curr;
+	double goal;
+	int next = 0;
+	int ticks = 0;
+	int i;
+
+	prebuild = built;
+	nladder = 0;
+	ncommits = 0;
+	simtime = 1000.0;
+	transition_init(&trans,from);
+	while( (next<count) || transition_active(&trans) ){
+		if( ++ticks>MAX_COMMITS )
+			break;
+		if( (next<count) && (!transition_active(&trans)
+					|| (1000.0+storm[next].time<=transition_next_deadline(&trans))) ){
+			(void)transition_sleep_until(1000.0+storm[next].time);
+			target_set = storm[next++].target;
+			transition_set_target(&trans,target_set,speed,simtime);
+			continue;
+		}
+		(void)transition_sleep_until(transition_next_deadline(&trans));
+		TEST_CHECK(transition_tick(&trans,simtime));
+	}
+	TEST_CHECKF(!transition_active(&trans),"%s at %dK/s did not finish",name,
+			speed);
+	TEST_CHECKF((ncommits>0) && (commits[ncommits-1].temp==target_set),
+			"%s at %dK/s ended on %dK, not %dK",name,speed,
+			ncommits ? commits[ncommits-1].temp : 0,target_set);
+	TEST_CHECK(trans.curr==target_set);
+	for( i=0; i<ncommits; ++i ){
+		prev = MIRED(i ? commits[i-1].temp : from);
+		curr = MIRED(commits[i].temp);
+		goal = MIRED(commits[i].target);
+		TEST_CHECKF(!i || (commits[i].temp!=commits[i-1].temp),
+				"%s at %dK/s: %dK committed twice",name,speed,commits[i].temp);
+		// Closer to the target in effect, without passing it
+		TEST_CHECKF((fabs(goal-curr)<fabs(goal-prev))
+				&& ((goal-curr)*(goal-prev)>=0.0),
+				"%s at %dK/s: step %d from %.0fK to %dK heads away from %dK",
+				name,speed,i,1e6/prev,commits[i].temp,commits[i].target);
+		if( built && (commits[i].temp!=commits[i].target) )
+			TEST_CHECKF(commits[i].built,"%s at %dK/s: %dK is not prebuilt",
+					name,speed,commits[i].temp);
+	}
+	if( ladders>0 )
+		TEST_CHECKF(trans.ladders<=ladders,"%s at %dK/s: %lu ladders built",
+				name,speed,trans.ladders);
+}
+
+// Slider dragged down and back up, 60 events per second with jitter
+static int make_slider(storm_s *storm, int max){
+	double t;
+	double x;
+	int n;
+
+	for( n=0; n<max; ++n ){
+		t = n/60.0;
+		if( t>=4.0 )
+			break;
+		x = (t<2.0) ? 6500.0-1550.0*t : 3400.0+1550.0*(t-2.0);
+		x += (double)(n%7-3)*10.0;
+		storm[n].time = t;
+		storm[n].target = 100*(int)(x/100.0);
+	}
+	return n;
+}
+
+// Pseudo random targets at pseudo random times
+static int make_random(storm_s *storm, int max, unsigned int seed){
+	double t = 0.0;
+	int n;
+
+	for( n=0; n<max; ++n ){
+		seed = seed*1103515245u+12345u;
+		t += (double)((seed>>16)%500)/1000.0;
+		seed = seed*1103515245u+12345u;
+		storm[n].time = t;
+		storm[n].target = MIN_TEMP+(int)((seed>>16)%(MAX_TEMP-MIN_TEMP+1));
+	}
+	return n;
+}
+
+int main(void){
+	static const int speeds[] = {100,300,1000,3000};
+	static const int ways[][2] = {
+		{6500,3400},{3400,6500},{5500,4500},{4000,3600},{6200,6800}};
+	// Turning around within the way first set, at 300K/s none of the
+	// ways finishes before the next target, so one ladder does
+	static const storm_s inside[] = {
+		{0.0,3400},{1.0,5000},{1.5,6400},{2.5,4000},{3.0,4500},{3.2,3400}};
+	storm_s storm[256];
+	int count;
+	int i;
+	int j;
+
+	TEST_BEGIN();
+	transition_set_clock(&fake_clock);
+	for( i=0; i<(int)(sizeof(speeds)/sizeof(int)); ++i ){
+		for( j=0; j<(int)(sizeof(ways)/sizeof(ways[0])); ++j ){
+			check_transition(ways[j][0],ways[j][1],speeds[i],0);
+			check_transition(ways[j][0],ways[j][1],speeds[i],1);
+		}
+	}
+	count = make_slider(storm,256);
+	for( i=0; i<(int)(sizeof(speeds)/sizeof(int)); ++i ){
+		check_storm("slider",storm,count,6500,speeds[i],0,0);
+		check_storm("slider",storm,count,6500,speeds[i],1,0);
+		if( speeds[i]==300 )
+			check_storm("inside",inside,(int)(sizeof(inside)/sizeof(storm_s)),
+					6500,speeds[i],1,1);
+		for( j=1; j<=4; ++j ){
+			count = make_random(storm,64,(unsigned int)j);
+			check_storm("random",storm,count,6500,speeds[i],0,0);
+			check_storm("random",storm,count,6500,speeds[i],1,0);
+		}
+		count = make_slider(storm,256);
+	}
+	transition_set_clock(NULL);
+	return TEST_END();
+}
@@ -41,6 +41,9 @@ typedef struct _argitem {
 static ArgItem *validitems = NULL;		// Valid arguments
 static ArgItem *unknown = NULL;			// Unknown arguments
 static ArgItem *unnamed = NULL;			// Additional unnamed arguments
+static ArgItem *lastvalid = NULL;		// Tails of the lists, reset by
+static ArgItem *lastunknown = NULL;		// args_free() so arguments can be
+static ArgItem *lastunnamed = NULL;		// added and parsed again
 static ArgBool parsed = ARGBOOL_FALSE;	// Whether parsed or not
 static const unsigned int MAX_LONG_LEN = 10;	// Maximum length of long names
 static const unsigned int MAX_HELP_LEN = 2048;	// Maximum length of help strings
@@ -82,7 +85,6 @@ ArgReturn args_addarg(
 	ArgReturn ret = ARGRET_OK;
 	ArgItem *newitem = (ArgItem*)malloc(sizeof(ArgItem));
 	static ArgItem empty = {0};
-	static ArgItem *lastadded=NULL;
 
 	if( !newitem )
 		return ARGRET_MEM_ERROR;
@@ -131,11 +133,11 @@ ArgReturn args_addarg(
 	}
 	newitem->valtype = valtype;
 	newitem->used = ARGBOOL_FALSE;
-	if( lastadded )
-		lastadded->next = newitem;
+	if( lastvalid )
+		lastvalid->next = newitem;
 	else
 		validitems = newitem;
-	lastadded = newitem;
+	lastvalid = newitem;
 	return ret;
 }
 
@@ -197,7 +199,6 @@ static ArgItem *_args_setval(
 // Internal function to store unknown arguments
 static ArgItem *_args_setunknown(const ArgStr arg){
 	ArgItem *newitem = (ArgItem*)malloc(sizeof(ArgItem));
-	static ArgItem *lastadded = NULL;
 
 	if( !newitem )
 		return NULL;
@@ -208,18 +209,17 @@ static ArgItem *_args_setunknown(const ArgStr arg){
 	}
 	strcpy(newitem->value, arg);
 	newitem->next = NULL;
-	if( lastadded )
-		lastadded->next = newitem;
+	if( lastunknown )
+		lastunknown->next = newitem;
 	else
 		unknown = newitem;
-	lastadded = newitem;
+	lastunknown = newitem;
 	return newitem;
 }
 
 // Internal function to store additional unnamed arguments
 static ArgItem *_args_setunnamed(const ArgStr arg){
 	ArgItem *newitem = (ArgItem*)malloc(sizeof(ArgItem));
-	static ArgItem *lastadded = NULL;
 
 	if( !newitem )
 		return NULL;
@@ -230,11 +230,11 @@ static ArgItem *_args_setunnamed(const ArgStr arg){
 	}
 	strcpy(newitem->value, arg);
 	newitem->next = NULL;
-	if( lastadded )
-		lastadded->next = newitem;
+	if( lastunnamed )
+		lastunnamed->next = newitem;
 	else
 		unnamed = newitem;
-	lastadded = newitem;
+	lastunnamed = newitem;
 	return newitem;
 }
 
@@ -556,6 +556,10 @@ void args_free(void)
 	validitems = NULL;
 	unknown = NULL;
 	unnamed = NULL;
+	lastvalid = NULL;
+	lastunknown = NULL;
+	lastunnamed = NULL;
+	parsed = ARGBOOL_FALSE;
 }
 
 #ifdef ARGS_TEST
@@ -0,0 +1,120 @@
+/**\file		benchctl.c
+ * \brief		Times control commands against oneshot runs.
+ * \details
+ * Sends a command to the running console daemon over its control socket
+ * and times the round trip.  When a program is given it is also run to
+ * completion the same number of times, so the cost of a whole process can
+ * be compared, e.g. "redshiftgui --ctl status" against "redshiftgui -o".
+ * The output of the command and the program is discarded.
+ *
+ * Usage: benchctl [-n RUNS] [-c COMMAND] [PROGRAM [ARGS]]
+ *	- RUNS defaults to 200
+ *	- COMMAND defaults to "status"
+ */
+
+#include "../common.h"
+#include <fcntl.h>
+#include <sys/wait.h>
+#include "../control.h"
+#include "../systemtime.h"
+
+/* Runs timed unless given */
+#define DEFAULT_RUNS 200
+
+// Milliseconds per control round trip, -1 if one failed
+static double time_control(const char *cmd, int runs){
+	double start;
+	double end;
+	int out = dup(STDOUT_FILENO);
+	int null = open("/dev/null",O_WRONLY);
+	int ok = (out>=0) && (null>=0);
+	int i;
+
+	// control_send() prints the answer
+	(void)fflush(stdout);
+	if( ok )
+		ok = (dup2(null,STDOUT_FILENO)>=0);
+	(void)systemtime_get_monotonic(&start);
+	for( i=0; ok && (i<runs); ++i ){
+		ok = control_send(cmd);
+		(void)fflush(stdout);
+	}
+	(void)systemtime_get_monotonic(&end);
+	if( out>=0 ){
+		(void)dup2(out,STDOUT_FILENO);
+		(void)close(out);
+	}
+	if( null>=0 )
+		(void)close(null);
+	return ok ? (end-start)/runs*1e3 : -1.0;
+}
+
+// Milliseconds per run of a program, -1 if one failed
+static double time_program(char *argv[], int runs){
+	double start;
+	double end;
+	pid_t pid;
+	int status;
+	int null;
+	int i;
+
+	(void)systemtime_get_monotonic(&start);
+	for( i=0; i<runs; ++i ){
+		pid = fork();
+		if( pid<0 )
+			return -1.0;
+		if( pid==0 ){
+			if( (null=open("/dev/null",O_WRONLY))>=0 ){
+				(void)dup2(null,STDOUT_FILENO);
+				(void)dup2(null,STDERR_FILENO);
+			}
+			(void)execvp(argv[0],argv);
+			_exit(127);
+		}
+		if( (waitpid(pid,&status,0)!=pid) || !WIFEXITED(status)
+				|| (WEXITSTATUS(status)==127) )
+			return -1.0;
+	}
+	(void)systemtime_get_monotonic(&end);
+	return (end-start)/runs*1e3;
+}
+
+int main(int argc, char *argv[]){
+	const char *cmd = "status";
+	int runs = DEFAULT_RUNS;
+	double ms;
+	int i;
+
+	for( i=1; (i<argc) && (argv[i][0]=='-'); ++i ){
+		if( (strcmp(argv[i],"-n")==0) && (i+1<argc) )
+			runs = atoi(argv[++i]);
+		else if( (strcmp(argv[i],"-c")==0) && (i+1<argc) )
+			cmd = argv[++i];
+		else
+			runs = 0;
+	}
+	if( runs<=0 ){
+		fprintf(stderr,"Usage: %s [-n RUNS] [-c COMMAND] [PROGRAM [ARGS]]\n",
+				argv[0]);
+		return 2;
+	}
+	if( log_init(NULL,LOGBOOL_FALSE,NULL)!=LOGRET_OK )
+		return 1;
+	(void)log_setlevel(LOGWARN);
+	if( (ms=time_control(cmd,runs))<0.0 ){
+		fprintf(stderr,"Command \"%s\" failed\n",cmd);
+		log_end();
+		return 1;
+	}
+	printf("control \"%s\": %.3fms\n",cmd,ms);
+	if( i<argc ){
+		if( (ms=time_program(argv+i,runs))<0.0 ){
+			fprintf(stderr,"Unable to run %s\n",argv[i]);
+			log_end();
+			return 1;
+		}
+		printf("%s: %.3fms\n",argv[i],ms);
+	}
+	log_end();
+	return 0;
+}
@@ -0,0 +1,119 @@
+/**\file		benchramp.c
+ * \brief		Benchmarks the gamma ramp kernels.
+ * \details
+ * Times every ramp kernel the CPU supports against the libm loop that
+ * gamma_ramp_fill() used before the kernels, one 3 channel ramp per run,
+ * and reports the largest difference to that loop in LSB over a range of
+ * sizes and gamma tweaks.
+ *
+ * Usage: benchramp [RUNS]
+ *	- RUNS is the number of ramps timed per size (defaults to 2000)
+ */
+
+#include "../common.h"
+#include "../gamma_simd.h"
+#include "../systemtime.h"
+
+/* Ramps timed per size unless given */
+#define DEFAULT_RUNS 2000
+/* Brightness and white point channel of the runs */
+#define BENCH_BRIGHTNESS 0.83f
+#define BENCH_WHITE 0.7479f
+
+static const int sizes[] = {256,1024,4096,1000,77};
+/* Only the usual sizes are timed */
+#define TIMED_SIZES 3
+static const float tweaks[] = {1.0f,0.5f,0.8f,1.7f,3.0f};
+
+// Fills one channel the way gamma_ramp_fill() did before the kernels
+static void fill_libm(uint16_t *out, int size, float tweak){
+	int i;
+
+	for( i=0; i<size; ++i )
+		out[i] = (uint16_t)(BENCH_BRIGHTNESS*(pow((float)i/size,1.0f/tweak)
+				*UINT16_MAX*BENCH_WHITE));
+}
+
+// Fills one channel with the selected kernel
+static void fill_kernel(uint16_t *out, float *curve, int size, float tweak){
+	gamma_simd_curve(curve,size,1.0f/tweak);
+	gamma_simd_scale(out,curve,size,
+			(float)(BENCH_BRIGHTNESS*UINT16_MAX*BENCH_WHITE));
+}
+
+// Largest difference to the libm loop in LSB
+static int max_error(float *curve, uint16_t *out, uint16_t *ref){
+	int err = 0;
+	int i;
+	int j;
+	int k;
+
+	for( i=0; i<(int)(sizeof(sizes)/sizeof(int)); ++i ){
+		for( j=0; j<(int)(sizeof(tweaks)/sizeof(float)); ++j ){
+			fill_kernel(out,curve,sizes[i],tweaks[j]);
+			fill_libm(ref,sizes[i],tweaks[j]);
+			for( k=0; k<sizes[i]; ++k )
+				err = MAX(err,abs((int)out[k]-(int)ref[k]));
+		}
+	}
+	return err;
+}
+
+// Microseconds per 3 channel ramp
+static double time_fill(int kernel, float *curve, uint16_t *out, int size,
+		int runs){
+	double start;
+	double end;
+	int i;
+	int j;
+
+	(void)systemtime_get_monotonic(&start);
+	for( i=0; i<runs; ++i ){
+		for( j=0; j<3; ++j ){
+			if( kernel )
+				fill_kernel(out+j*size,curve,size,0.8f);
+			else
+				fill_libm(out+j*size,size,0.8f);
+		}
+	}
+	(void)systemtime_get_monotonic(&end);
+	return (end-start)/runs*1e6;
+}
+
+int main(int argc, char *argv[]){
+	int runs = (argc>1) ? atoi(argv[1]) : DEFAULT_RUNS;
+	int most = sizes[TIMED_SIZES-1];
+	float *curve = (float*)malloc(sizeof(float)*most);
+	uint16_t *out = (uint16_t*)malloc(sizeof(uint16_t)*most*3);
+	uint16_t *ref = (uint16_t*)malloc(sizeof(uint16_t)*most);
+	int kernel;
+	int i;
+
+	if( (log_init(NULL,LOGBOOL_FALSE,NULL)!=LOGRET_OK) || (runs<=0)
+			|| !curve || !out || !ref ){
+		fprintf(stderr,"Usage: %s [RUNS]\n",argv[0]);
+		return 1;
+	}
+	printf("%-8s","size");
+	for( i=0; i<TIMED_SIZES; ++i )
+		printf("%10d",sizes[i]);
+	printf("   max error\n%-8s","libm");
+	for( i=0; i<TIMED_SIZES; ++i )
+		printf("%8.1fus",time_fill(0,curve,out,sizes[i],runs));
+	printf("\n");
+	for( kernel=GAMMA_SIMD_SCALAR; kernel<GAMMA_SIMD_MAX; ++kernel ){
+		if( gamma_simd_select((gamma_simd_t)kernel)!=(gamma_simd_t)kernel ){
+			printf("%-8s   not supported\n",gamma_simd_name((gamma_simd_t)kernel));
+			continue;
+		}
+		printf("%-8s",gamma_simd_name((gamma_simd_t)kernel));
+		for( i=0; i<TIMED_SIZES; ++i )
+			printf("%8.1fus",time_fill(1,curve,out,sizes[i],runs));
+		printf("%8d LSB\n",max_error(curve,out,ref));
+	}
+	free(curve);
+	free(out);
+	free(ref);
+	log_end();
+	return 0;
+}
@@ -0,0 +1,132 @@
+/**\file		benchresample.c
+ * \brief		Benchmarks master ramp resampling.
+ * \details
+ * Times one transition step over 2, 4 and 6 outputs of mixed ramp sizes,
+ * once filling every output and once filling a master ramp at the
+ * largest size and resampling it, the way the RANDR backend does with
+ * --resample.  The ramp cache is disabled so every step computes, as it
+ * does for a temperature not seen before.  Both ways must give the same
+ * ramps, the largest difference is reported in LSB.
+ *
+ * Usage: benchresample [RUNS]
+ *	- RUNS is the number of steps timed per layout (defaults to 3600)
+ */
+
+#include "../common.h"
+#include "../gamma.h"
+#include "../gamma_simd.h"
+#include "../options.h"
+#include "../systemtime.h"
+
+/* Steps timed per layout unless given */
+#define DEFAULT_RUNS 3600
+/* Most outputs of a layout */
+#define MAX_OUTPUTS 6
+
+/* Output layouts, ramp sizes ending with 0 */
+static const int layouts[][MAX_OUTPUTS+1] = {
+	{1024,256,0},
+	{4096,1024,256,256,0},
+	{4096,4096,1024,1024,256,256,0}};
+
+/* The gamma module wants a backend, none is loaded */
+#ifdef ENABLE_RANDR
+int randr_load_funcs(gamma_method_s *method){
+	(void)method;
+	return RET_FUN_SUCCESS;
+}
+#endif
+#ifdef ENABLE_VIDMODE
+int vidmode_load_funcs(gamma_method_s *method){
+	(void)method;
+	return RET_FUN_SUCCESS;
+}
+#endif
+
+// Temperature of step i, each step a different one
+static int step_temp(int i){
+	return MIN_TEMP+i%(MAX_TEMP-MIN_TEMP);
+}
+
+// Microseconds per step, filling each output or resampling a master
+static double time_steps(gamma_ramp_s *ramps, int count, gamma_ramp_s *master,
+		int runs){
+	double start;
+	double end;
+	int i;
+	int j;
+
+	(void)systemtime_get_monotonic(&start);
+	for( i=0; i<runs; ++i ){
+		if( master )
+			(void)gamma_ramp_fill(master,step_temp(i));
+		for( j=0; j<count; ++j ){
+			if( !master || !gamma_ramp_resample(master,&ramps[j]) )
+				(void)gamma_ramp_fill(&ramps[j],step_temp(i));
+		}
+	}
+	(void)systemtime_get_monotonic(&end);
+	return (end-start)/runs*1e6;
+}
+
+// Largest difference between the two ways in LSB
+static int max_error(gamma_ramp_s *ramps, gamma_ramp_s *direct, int count,
+		gamma_ramp_s *master){
+	int err = 0;
+	int temp;
+	int i;
+	int j;
+
+	for( temp=MIN_TEMP; temp<=MAX_TEMP; temp+=100 ){
+		(void)gamma_ramp_fill(master,temp);
+		for( i=0; i<count; ++i ){
+			(void)gamma_ramp_resample(master,&ramps[i]);
+			(void)gamma_ramp_fill(&direct[i],temp);
+			for( j=0; j<3*ramps[i].size; ++j )
+				err = MAX(err,abs((int)ramps[i].all[j]-(int)direct[i].all[j]));
+		}
+	}
+	return err;
+}
+
+int main(int argc, char *argv[]){
+	gamma_ramp_s ramps[MAX_OUTPUTS];
+	gamma_ramp_s direct[MAX_OUTPUTS];
+	gamma_ramp_s master;
+	int runs = (argc>1) ? atoi(argv[1]) : DEFAULT_RUNS;
+	int count;
+	int i;
+	int j;
+
+	if( (log_init(NULL,LOGBOOL_FALSE,NULL)!=LOGRET_OK) || (runs<=0) ){
+		fprintf(stderr,"Usage: %s [RUNS]\n",argv[0]);
+		return 1;
+	}
+	(void)log_setlevel(LOGWARN);
+	opt_init();
+	printf("%s kernel, %d steps\n",gamma_simd_name(gamma_simd_init()),runs);
+	gamma_cache_set_limit(0);
+	for( i=0; i<(int)(sizeof(layouts)/sizeof(layouts[0])); ++i ){
+		for( count=0; layouts[i][count]; ++count ){
+			ramps[count] = gamma_pool_get(layouts[i][count]);
+			direct[count] = gamma_pool_get(layouts[i][count]);
+		}
+		master = gamma_pool_get(layouts[i][0]);
+		printf("%d outputs (",count);
+		for( j=0; j<count; ++j )
+			printf("%s%d",j ? "," : "",layouts[i][j]);
+		printf("): fill %.1fus, resample %.1fus, max error %d LSB\n",
+				time_steps(ramps,count,NULL,runs),
+				time_steps(ramps,count,&master,runs),
+				max_error(ramps,direct,count,&master));
+		for( j=0; j<count; ++j ){
+			gamma_pool_put(&ramps[j]);
+			gamma_pool_put(&direct[j]);
+		}
+		gamma_pool_put(&master);
+	}
+	gamma_pool_clear();
+	opt_free();
+	log_end();
+	return 0;
+}
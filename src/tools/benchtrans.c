@@ -0,0 +1,141 @@
+/**\file		benchtrans.c
+ * \brief		Counts backend calls per transition.
+ * \details
+ * Runs day/night transitions on a fake clock, like the transition tests,
+ * and counts the temperatures committed to a fake backend that takes a
+ * fixed time per call.  The transition engine is compared with the
+ * stepping it replaced, linear in kelvin with a commit every step period,
+ * which is modeled here since it no longer exists in the tree.
+ *
+ * Usage: benchtrans [LATENCY_MS]
+ *	- LATENCY_MS is the time a backend call takes (defaults to 0.05)
+ */
+
+#include "../common.h"
+#include "../gamma.h"
+#include "../options.h"
+#include "../transition.h"
+
+/* Backend latency unless given, in seconds */
+#define DEFAULT_LATENCY 0.00005
+
+/* Fake clock and backend */
+static double simtime = 0.0;
+static double latency = DEFAULT_LATENCY;
+static int calls = 0;
+
+static int fake_now(double *now){
+	*now = simtime;
+	return RET_FUN_SUCCESS;
+}
+
+static int fake_sleep_until(double deadline){
+	if( deadline>simtime )
+		simtime = deadline;
+	return RET_FUN_SUCCESS;
+}
+
+static const transition_clock_s fake_clock = {&fake_now,&fake_sleep_until};
+
+/* Stand-ins for the gamma and options modules */
+int gamma_state_set_temperature(int temp, gamma_s gamma){
+	(void)temp;
+	(void)gamma;
+	++calls;
+	simtime += latency;
+	return RET_FUN_SUCCESS;
+}
+
+int gamma_state_paused(void){
+	return 0;
+}
+
+int gamma_ladder_build(const int *temps, int count){
+	(void)temps;
+	(void)count;
+	return RET_FUN_SUCCESS;
+}
+
+void gamma_ladder_free(void){
+}
+
+int opt_get_trans_budget(void){
+	return DEFAULT_TRANS_BUDGET;
+}
+
+int opt_get_prebuild(void){
+	return 0;
+}
+
+gamma_s opt_get_gamma(void){
+	gamma_s gamma = {1.0f,1.0f,1.0f};
+	return gamma;
+}
+
+// Backend calls of the transition engine
+static int calls_mired(int from, int target, int speed){
+	transition_s trans;
+
+	calls = 0;
+	transition_init(&trans,from);
+	transition_set_target(&trans,target,speed,simtime);
+	while( transition_active(&trans) ){
+		(void)transition_sleep_until(transition_next_deadline(&trans));
+		(void)transition_tick(&trans,simtime);
+	}
+	return calls;
+}
+
+// Backend calls of the old stepping, linear in kelvin, a commit per step
+static int calls_kelvin(int from, int target, int speed){
+	double duration = fabs((double)(target-from))/speed;
+	double start = simtime;
+	double deadline = simtime;
+	double interval = TRANSITION_STEP;
+
+	calls = 0;
+	for( ;; ){
+		(void)fake_sleep_until(MIN(deadline,start+duration));
+		if( simtime-start+interval/2>=duration ){
+			(void)gamma_state_set_temperature(target,opt_get_gamma());
+			return calls;
+		}
+		(void)gamma_state_set_temperature(from+(int)((target-from)
+				*((simtime-start)/duration)),opt_get_gamma());
+		// Budget share of the commit time, at least 1K per step
+		interval = MAX(latency*100.0/opt_get_trans_budget(),1.0/speed);
+		interval = MIN(MAX(interval,TRANSITION_STEP_MIN),TRANSITION_STEP_MAX);
+		deadline += interval;
+		if( simtime>=deadline )
+			deadline += (floor((simtime-deadline)/interval)+1.0)*interval;
+	}
+}
+
+int main(int argc, char *argv[]){
+	static const int speeds[] = {1000,100,10};
+	static const int ways[][2] = {{6500,3600},{3600,6500}};
+	int i;
+	int j;
+
+	if( argc>1 )
+		latency = atof(argv[1])/1000.0;
+	if( (log_init(NULL,LOGBOOL_FALSE,NULL)!=LOGRET_OK) || (latency<0.0) ){
+		fprintf(stderr,"Usage: %s [LATENCY_MS]\n",argv[0]);
+		return 1;
+	}
+	(void)log_setlevel(LOGWARN);
+	transition_set_clock(&fake_clock);
+	// Lets the engine time a commit first, as the daemon's first step does
+	(void)calls_mired(6500,6400,1000);
+	printf("backend %.2fms   kelvin   mired\n",latency*1000.0);
+	for( i=0; i<(int)(sizeof(ways)/sizeof(ways[0])); ++i ){
+		for( j=0; j<(int)(sizeof(speeds)/sizeof(int)); ++j ){
+			printf("%d->%dK %5dK/s %7d %7d\n",ways[i][0],ways[i][1],speeds[j],
+					calls_kelvin(ways[i][0],ways[i][1],speeds[j]),
+					calls_mired(ways[i][0],ways[i][1],speeds[j]));
+		}
+	}
+	transition_set_clock(NULL);
+	log_end();
+	return 0;
+}
@@ -0,0 +1,233 @@
+/**\file		genwhitepoint.c
+ * \brief		Generates the temperature to white point table.
+ * \details
+ * Build time helper that writes gamma_vals.h. The table is either
+ * resampled from a CSV file (one "R, G, B" row per 100K starting at 1000K,
+ * the format of scripts/gammars.csv) or computed from the Planckian locus.
+ * With -f binary it writes a table file that can be loaded at runtime
+ * instead (see wptable.h).
+ *
+ * Usage: genwhitepoint [-f header|binary] [-s STEP] [-o OUTPUT] SOURCE
+ *	- SOURCE is a CSV file or "planck"
+ *	- STEP is the table resolution in K (defaults to 100)
+ *	- OUTPUT defaults to standard output
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "../gamma.h"
+#include "../wptable.h"
+
+/* Range of the generated table */
+#define TABLE_MIN	1000
+#define TABLE_MAX	10000
+/* Temperature of the first CSV row and spacing between rows */
+#define CSV_BASE	1000
+#define CSV_STEP	100
+/* Maximum number of CSV rows */
+#define CSV_MAX_ROWS	1024
+
+typedef struct{
+	float r;
+	float g;
+	float b;
+} rgb_t;
+
+// Reads "R, G, B" rows, ignores anything that is not a number
+static int read_csv(const char *file, rgb_t *rows, int maxrows){
+	char line[256];
+	int cnt = 0;
+	FILE *fid = fopen(file,"r");
+	if( fid==NULL ){
+		perror(file);
+		return 0;
+	}
+	while( (cnt<maxrows) && fgets(line,(int)sizeof(line),fid) ){
+		float v[3];
+		int n = 0;
+		char *curr = line;
+		while( (n<3) && (*curr!='\0') ){
+			char *end;
+			double val = strtod(curr,&end);
+			if( end==curr ){
+				++curr;
+				continue;
+			}
+			v[n++] = (float)val;
+			curr = end;
+		}
+		if( n==0 )
+			continue;
+		if( n!=3 ){
+			fprintf(stderr,"%s:%d: expected 3 values\n",file,cnt+1);
+			(void)fclose(fid);
+			return 0;
+		}
+		rows[cnt].r = v[0];
+		rows[cnt].g = v[1];
+		rows[cnt].b = v[2];
+		++cnt;
+	}
+	(void)fclose(fid);
+	return cnt;
+}
+
+// Linearly interpolates CSV rows at temp
+static rgb_t csv_lookup(const rgb_t *rows, int cnt, int temp){
+	int offset = temp-CSV_BASE;
+	int index = offset/CSV_STEP;
+	float a = (float)(offset%CSV_STEP)/CSV_STEP;
+	rgb_t c;
+	if( index>=cnt-1 )
+		return rows[cnt-1];
+	if( a==0.0f )
+		return rows[index];
+	c.r = (1.0f-a)*rows[index].r + a*rows[index+1].r;
+	c.g = (1.0f-a)*rows[index].g + a*rows[index+1].g;
+	c.b = (1.0f-a)*rows[index].b + a*rows[index+1].b;
+	return c;
+}
+
+// sRGB transfer function
+static double srgb_encode(double c){
+	if( c<=0.0031308 )
+		return 12.92*c;
+	return 1.055*pow(c,1.0/2.4)-0.055;
+}
+
+// White point from the Planckian locus (Kim et al. cubic spline)
+static rgb_t planck_lookup(int temp){
+	double t = (double)temp;
+	double x,y,X,Z,r,g,b,m;
+	rgb_t c;
+	if( t<4000.0 )
+		x = -0.2661239e9/(t*t*t) - 0.2343589e6/(t*t)
+			+ 0.8776956e3/t + 0.179910;
+	else
+		x = -3.0258469e9/(t*t*t) + 2.1070379e6/(t*t)
+			+ 0.2226347e3/t + 0.240390;
+	if( t<2222.0 )
+		y = -1.1063814*x*x*x - 1.34811020*x*x + 2.18555832*x - 0.20219683;
+	else if( t<4000.0 )
+		y = -0.9549476*x*x*x - 1.37418593*x*x + 2.09137015*x - 0.16748867;
+	else
+		y = 3.0817580*x*x*x - 5.87338670*x*x + 3.75112997*x - 0.37001483;
+	/* xyY (Y=1) to XYZ to linear sRGB */
+	X = x/y;
+	Z = (1.0-x-y)/y;
+	r = 3.2404542*X - 1.5371385 - 0.4985314*Z;
+	g = -0.9692660*X + 1.8760108 + 0.0415560*Z;
+	b = 0.0556434*X - 0.2040259 + 1.0572252*Z;
+	/* Full intensity in the strongest channel */
+	m = r>g ? (r>b ? r : b) : (g>b ? g : b);
+	c.r = (float)srgb_encode(r>0.0 ? r/m : 0.0);
+	c.g = (float)srgb_encode(g>0.0 ? g/m : 0.0);
+	c.b = (float)srgb_encode(b>0.0 ? b/m : 0.0);
+	return c;
+}
+
+// Writes the C header
+static int write_header(FILE *out, const char *source, int step,
+		const rgb_t *rows, int cnt)
+{
+	int temp;
+	fprintf(out,"/* Generated by genwhitepoint from %s, do not edit. */\n",
+			source);
+	fprintf(out,"#ifndef __GAMMA_VALS_H__\n#define __GAMMA_VALS_H__\n\n");
+	fprintf(out,"/**\\brief Resolution of the white point table in K */\n");
+	fprintf(out,"#define GAMMA_VALS_STEP %d\n\n",step);
+	fprintf(out,"static temp_gamma blackbody_color[] ={\n");
+	for( temp=TABLE_MIN; temp<=TABLE_MAX; temp+=step ){
+		rgb_t c = rows ? csv_lookup(rows,cnt,temp) : planck_lookup(temp);
+		fprintf(out,"\t{%-5d,{%.4ff, %.4ff, %.4ff}}%s\n",temp,
+				c.r,c.g,c.b,(temp+step<=TABLE_MAX) ? "," : "");
+	}
+	fprintf(out,"};\n\n#endif//__GAMMA_VALS_H__\n");
+	return ferror(out)==0;
+}
+
+// Writes a table file for wptable_load()
+static int write_binary(FILE *out, int step, const rgb_t *rows, int cnt){
+	wptable_header_s hdr;
+	temp_gamma rec;
+	int temp;
+
+	memset(&hdr,0,sizeof(hdr));
+	memcpy(hdr.magic,WPTABLE_MAGIC,sizeof(hdr.magic));
+	hdr.version = WPTABLE_VERSION;
+	hdr.record_size = (uint32_t)sizeof(temp_gamma);
+	hdr.count = (uint32_t)((TABLE_MAX-TABLE_MIN)/step+1);
+	if( fwrite(&hdr,sizeof(hdr),1,out)!=1 )
+		return 0;
+	for( temp=TABLE_MIN; temp<=TABLE_MAX; temp+=step ){
+		rgb_t c = rows ? csv_lookup(rows,cnt,temp) : planck_lookup(temp);
+		memset(&rec,0,sizeof(rec));
+		rec.temp = temp;
+		rec.gamma.r = c.r;
+		rec.gamma.g = c.g;
+		rec.gamma.b = c.b;
+		if( fwrite(&rec,sizeof(rec),1,out)!=1 )
+			return 0;
+	}
+	return ferror(out)==0;
+}
+
+int main(int argc, char *argv[]){
+	int step = 100;
+	int binary = 0;
+	const char *outfile = NULL;
+	const char *source = NULL;
+	rgb_t *rows = NULL;
+	int cnt = 0;
+	int i;
+	int ok;
+	FILE *out = stdout;
+
+	for( i=1; i<argc; ++i ){
+		if( (strcmp(argv[i],"-s")==0) && (i+1<argc) )
+			step = atoi(argv[++i]);
+		else if( (strcmp(argv[i],"-o")==0) && (i+1<argc) )
+			outfile = argv[++i];
+		else if( (strcmp(argv[i],"-f")==0) && (i+1<argc) )
+			binary = (strcmp(argv[++i],"binary")==0);
+		else
+			source = argv[i];
+	}
+	if( (source==NULL) || (step<=0) || ((TABLE_MAX-TABLE_MIN)%step) ){
+		fprintf(stderr,"Usage: %s [-f header|binary] [-s STEP] [-o OUTPUT]"
+				" CSVFILE|planck\n"
+				"STEP must divide %d\n",argv[0],TABLE_MAX-TABLE_MIN);
+		return 1;
+	}
+	if( strcmp(source,"planck")!=0 ){
+		rows = (rgb_t*)malloc(sizeof(rgb_t)*CSV_MAX_ROWS);
+		if( rows==NULL )
+			return 1;
+		cnt = read_csv(source,rows,CSV_MAX_ROWS);
+		if( cnt<2 ){
+			fprintf(stderr,"%s: not enough rows\n",source);
+			free(rows);
+			return 1;
+		}
+	}
+	if( outfile ){
+		out = fopen(outfile,binary ? "wb" : "w");
+		if( out==NULL ){
+			perror(outfile);
+			free(rows);
+			return 1;
+		}
+	}
+	if( binary )
+		ok = write_binary(out,step,rows,cnt);
+	else
+		ok = write_header(out,source,step,rows,cnt);
+	if( outfile )
+		ok = (fclose(out)==0) && ok;
+	free(rows);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+/**\file		rsgstatus.c
+ * \brief		Prints the state of the running console mode.
+ * \details
+ * Reads the status segment published by the console daemon (see
+ * status.h).  The segment is mapped once, so a status bar can keep this
+ * running with -w and no reading costs a system call.
+ *
+ * Usage: rsgstatus [-w SECONDS] [FIELD]
+ *	- FIELD prints only that value: temp, target, elevation, bright, mode,
+ *	  paused, suppressed, pid or age
+ *	- SECONDS prints again at that interval until interrupted
+ *
+ * Exits with 1 if no daemon is running.
+ */
+
+#include "../common.h"
+#include "../status.h"
+
+// Prints one field or all of them
+static int print_status(const status_s *s, /*@null@*/ const char *field){
+	double now = (double)time(NULL);
+	// Whole seconds against a fractional update time
+	double age = (s->mode==STATUS_MODE_STOPPED) ? 0.0
+		: MAX(floor(now-s->updated),0.0);
+
+	if( !field )
+		printf("temp=%d target=%d elevation=%.2f bright=%.2f mode=%s"
+				" paused=%d suppressed=%llu pid=%d age=%.0f\n",s->temp,s->target,
+				s->elevation,s->brightness,status_mode_name(s->mode),s->paused,
+				(unsigned long long)s->suppressed,s->pid,age);
+	else if( strcmp(field,"temp")==0 )
+		printf("%d\n",s->temp);
+	else if( strcmp(field,"target")==0 )
+		printf("%d\n",s->target);
+	else if( strcmp(field,"elevation")==0 )
+		printf("%.2f\n",s->elevation);
+	else if( strcmp(field,"bright")==0 )
+		printf("%.2f\n",s->brightness);
+	else if( strcmp(field,"mode")==0 )
+		printf("%s\n",status_mode_name(s->mode));
+	else if( strcmp(field,"paused")==0 )
+		printf("%d\n",s->paused);
+	else if( strcmp(field,"suppressed")==0 )
+		printf("%llu\n",(unsigned long long)s->suppressed);
+	else if( strcmp(field,"pid")==0 )
+		printf("%d\n",s->pid);
+	else if( strcmp(field,"age")==0 )
+		printf("%.0f\n",age);
+	else{
+		fprintf(stderr,"Unknown field: %s\n",field);
+		return 0;
+	}
+	(void)fflush(stdout);
+	return 1;
+}
+
+int main(int argc, char *argv[]){
+	const status_s *shm;
+	status_s snap;
+	const char *field = NULL;
+	int interval = 0;
+	int ret;
+	int i;
+
+	for( i=1; i<argc; ++i ){
+		if( (strcmp(argv[i],"-w")==0) && (i+1<argc) )
+			interval = atoi(argv[++i]);
+		else if( argv[i][0]=='-' ){
+			fprintf(stderr,"Usage: %s [-w SECONDS] [FIELD]\n",argv[0]);
+			return 2;
+		}else
+			field = argv[i];
+	}
+	if( log_init(NULL,LOGBOOL_FALSE,NULL)!=LOGRET_OK )
+		return 1;
+	(void)log_setlevel(LOGWARN);
+	if( !(shm=status_open()) ){
+		log_end();
+		return 1;
+	}
+	do{
+		if( !status_read(shm,&snap) ){
+			fprintf(stderr,"Invalid status segment\n");
+			ret = 1;
+			break;
+		}
+		if( !print_status(&snap,field) ){
+			ret = 2;
+			break;
+		}
+		ret = (snap.mode==STATUS_MODE_STOPPED) ? 1 : 0;
+		if( interval>0 )
+			(void)sleep((unsigned int)interval);
+	}while( interval>0 );
+	status_close(shm);
+	log_end();
+	return ret;
+}
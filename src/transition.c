@@ -0,0 +1,256 @@
+#include "common.h"
+#include "gamma.h"
+#include "options.h"
+#include "systemtime.h"
+#include "transition.h"
+
+static transition_clock_s system_clock = {
+	&systemtime_get_monotonic,&systemtime_sleep_until};
+static transition_clock_s active_clock = {
+	&systemtime_get_monotonic,&systemtime_sleep_until};
+// Commit latency depends on the backend, not on a transition
+static transition_stats_s stats;
+
+/* Weight of a new latency sample */
+#define LATENCY_SMOOTHING 0.25
+/* Temperature in mireds */
+#define MIRED(temp) (1e6/MAX((temp),1))
+
+/* Replaces the clock */
+void transition_set_clock(const transition_clock_s *clock){
+	active_clock = (clock!=NULL) ? *clock : system_clock;
+}
+
+/* Reads the clock */
+int transition_now(double *now){
+	return active_clock.now(now);
+}
+
+/* Sleeps on the clock */
+int transition_sleep_until(double deadline){
+	return active_clock.sleep_until(deadline);
+}
+
+// Step period that keeps commits within the budget
+static double transition_interval(int speed){
+	double interval;
+
+	if( stats.commits==0 )
+		return TRANSITION_STEP;
+	interval = stats.latency*100.0/opt_get_trans_budget();
+	// Steps under 1K are not worth a commit
+	if( speed>0 )
+		interval = MAX(interval,1.0/speed);
+	return MIN(MAX(interval,TRANSITION_STEP_MIN),TRANSITION_STEP_MAX);
+}
+
+// Commits temp and times the commit
+static int transition_commit(int temp, /*@out@*/ double *after){
+	double before;
+	double latency;
+	int ret;
+
+	if( !transition_now(&before) )
+		before = 0.0;
+	ret = gamma_state_set_temperature(temp,opt_get_gamma());
+	if( !transition_now(after) )
+		(*after) = before;
+	latency = MAX((*after)-before,0.0);
+	if( stats.commits==0 )
+		stats.latency = latency;
+	else
+		stats.latency += (latency-stats.latency)*LATENCY_SMOOTHING;
+	stats.latency_max = MAX(stats.latency_max,latency);
+	stats.latency_total += latency;
+	++stats.commits;
+	return ret;
+}
+
+// Temperature due at now, linear in mireds since the eye is far more
+// sensitive to warm steps
+static int transition_temp_at(const transition_s *trans, double now){
+	double from = MIRED(trans->from);
+	double target = MIRED(trans->target);
+	double elapsed = now-trans->start;
+
+	if( elapsed>=trans->duration )
+		return trans->target;
+	if( elapsed<=0.0 )
+		return trans->from;
+	return (int)(1e6/(from+(target-from)*(elapsed/trans->duration))+0.5);
+}
+
+// Temperature of a ladder rung, clamped to the ladder
+static int transition_rung(const transition_s *trans, int rung){
+	rung = MIN(MAX(rung,0),trans->rungs);
+	return (int)(1e6/(trans->rung0+trans->rung_step*rung)+0.5);
+}
+
+// Whether temp snaps to a rung of the ladder
+static int transition_on_ladder(const transition_s *trans, int temp){
+	double rung = (MIRED(temp)-trans->rung0)/trans->rung_step;
+
+	return (rung>=-0.5) && (rung<=trans->rungs+0.5);
+}
+
+// Splits the way into even mired steps no larger than TRANSITION_JND and
+// builds their ramps ahead of time
+static void transition_build_ladder(transition_s *trans, int retarget){
+	double span = MIRED(trans->target)-MIRED(trans->from);
+	double start = 0.0;
+	double end = 0.0;
+	int *temps;
+	int i;
+
+	// Turning back or stopping short within the ladder keeps its ramps
+	if( retarget && (trans->rungs>0) && opt_get_prebuild()
+			&& transition_on_ladder(trans,trans->from)
+			&& transition_on_ladder(trans,trans->target) )
+		return;
+	if( trans->rungs>0 )
+		gamma_ladder_free();
+	trans->rungs = 0;
+	// A jump commits the target at once, nothing to step through
+	if( !opt_get_prebuild() || (trans->speed<=0)
+			|| (fabs(span)<TRANSITION_JND) )
+		return;
+	(void)transition_now(&start);
+	trans->rungs = (int)ceil(fabs(span)/TRANSITION_JND);
+	trans->rung0 = MIRED(trans->from);
+	trans->rung_step = span/trans->rungs;
+	temps = (int*)malloc(sizeof(int)*(trans->rungs+1));
+	if( temps==NULL ){
+		trans->rungs = 0;
+		return;
+	}
+	for( i=0; i<=trans->rungs; ++i )
+		temps[i] = transition_rung(trans,i);
+	if( !gamma_ladder_build(temps,trans->rungs+1) )
+		trans->rungs = 0;
+	free(temps);
+	(void)transition_now(&end);
+	++trans->ladders;
+	LOG(LOGVERBOSE,_("Prebuilt %d transition steps in %.2fms (ladder %lu)"),
+			trans->rungs,(end-start)*1000.0,trans->ladders);
+}
+
+// Time at which the temperature is TRANSITION_JND away from the last commit
+static double transition_noticeable(const transition_s *trans){
+	double from = MIRED(trans->from);
+	double span = MIRED(trans->target)-from;
+	// Position of the last commit along the way, negative if behind
+	double pos = (MIRED(trans->curr)-from)*(span<0.0 ? -1.0 : 1.0);
+
+	if( (fabs(span)<TRANSITION_JND) || (-pos>=TRANSITION_JND) )
+		return trans->start;
+	return trans->start+trans->duration*(pos+TRANSITION_JND)/fabs(span);
+}
+
+/* Initializes an idle transition */
+void transition_init(transition_s *trans, int curr){
+	memset(trans,0,sizeof(*trans));
+	trans->curr = curr;
+	trans->from = curr;
+	trans->target = curr;
+}
+
+/* Starts or retargets a transition */
+void transition_set_target(transition_s *trans, int target, int speed,
+		double now){
+	int retarget = trans->active;
+
+	if( retarget && (trans->target==target) && (trans->speed==speed) )
+		return;
+	// Carry on from where the transition is now, not from the last commit
+	trans->from = retarget ? transition_temp_at(trans,now) : trans->curr;
+	trans->target = target;
+	trans->start = now;
+	if( speed>0 )
+		trans->duration = fabs((double)(target-trans->from))/speed;
+	else
+		trans->duration = 0.0;
+	trans->speed = speed;
+	trans->interval = transition_interval(speed);
+	trans->active = 1;
+	transition_build_ladder(trans,retarget);
+	// Keep the step period since the last commit
+	trans->deadline = MAX(now,trans->committed+trans->interval);
+	if( retarget ){
+		trans->deadline = MAX(trans->deadline,transition_noticeable(trans));
+		++trans->retargets;
+	}
+}
+
+/* Commits the temperature due at now */
+int transition_tick(transition_s *trans, double now){
+	double after;
+	double skip;
+	int temp = trans->target;
+
+	if( !trans->active )
+		return RET_FUN_SUCCESS;
+	// Paused writes collapse into one, no point in stepping
+	if( (now-trans->start+trans->interval/2<trans->duration)
+			&& !gamma_state_paused() )
+		temp = transition_temp_at(trans,now);
+	// Snap to the nearest prebuilt ramp
+	if( trans->rungs>0 )
+		temp = transition_rung(trans,(int)floor((MIRED(temp)-trans->rung0)
+				/trans->rung_step+0.5));
+	// Finish once the rest of the way is not noticeable
+	if( fabs(MIRED(trans->target)-MIRED(temp))<TRANSITION_JND ){
+		trans->active = 0;
+		if( trans->rungs>0 )
+			gamma_ladder_free();
+		trans->rungs = 0;
+		LOG(LOGVERBOSE,_("Target color reached: %dK (%lu steps, %lu dropped,"
+					" %lu retargets, %lu ladders)"),trans->target,trans->steps,
+				trans->dropped,trans->retargets,trans->ladders);
+		if( trans->curr==trans->target )
+			return RET_FUN_SUCCESS;
+		if( !transition_commit(trans->target,&after) )
+			return RET_FUN_FAILED;
+		trans->curr = trans->target;
+		trans->committed = after;
+		return RET_FUN_SUCCESS;
+	}
+	if( temp!=trans->curr ){
+		if( !transition_commit(temp,&after) )
+			return RET_FUN_FAILED;
+		trans->curr = temp;
+		trans->committed = after;
+		++trans->steps;
+	}else if( !transition_now(&after) )
+		after = now;
+	trans->interval = transition_interval(trans->speed);
+	LOG(LOGVERBOSE,_("Transition color: %dK (commit %.1fms, step %.0fms)"),
+			temp,stats.latency*1000.0,trans->interval*1000.0);
+	// Next grid point, skipping the ones already passed
+	trans->deadline += trans->interval;
+	if( after>=trans->deadline ){
+		skip = floor((after-trans->deadline)/trans->interval)+1.0;
+		trans->deadline += skip*trans->interval;
+		trans->dropped += (unsigned long)skip;
+		stats.dropped += (unsigned long)skip;
+	}
+	// Nothing to commit until the change becomes noticeable
+	trans->deadline = MAX(trans->deadline,transition_noticeable(trans));
+	return RET_FUN_SUCCESS;
+}
+
+/* Time of the next tick */
+double transition_next_deadline(const transition_s *trans){
+	if( !trans->active )
+		return -1.0;
+	return MIN(trans->deadline,trans->start+trans->duration);
+}
+
+/* Checks whether a transition is in progress */
+int transition_active(const transition_s *trans){
+	return trans->active;
+}
+
+/* Retrieves commit statistics */
+void transition_get_stats(transition_stats_s *out){
+	*out = stats;
+}
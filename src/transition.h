@@ -0,0 +1,144 @@
+/**\file		transition.h
+ * \brief		Temperature transitions shared by all front ends.
+ * \details
+ * A transition moves the temperature to a target at a fixed speed.  The
+ * temperature committed on each tick is computed from the time elapsed on
+ * a monotonic clock, linearly in mireds (1e6/K) so that steps look alike
+ * at both ends of the range.  Ticks fall on a grid of absolute deadlines and grid
+ * points missed because of a slow commit are dropped.  Front ends call
+ * transition_tick() at transition_next_deadline(), either by sleeping
+ * (console) or from a timer (GUI).
+ *
+ * Every commit is timed and the grid period follows the smoothed commit
+ * latency, so that commits take at most the budget set with
+ * opt_set_trans_budget() of the transition time.  Fast backends get smooth
+ * transitions, slow ones (many CRTCs, remote X) get fewer, larger steps.
+ * No tick is scheduled before the temperature has moved by TRANSITION_JND,
+ * and the target is set as soon as the rest of the way is below it.
+ *
+ * With opt_set_prebuild(), the way is split into even steps of at most
+ * TRANSITION_JND when the target is set, their ramps are built at once with
+ * gamma_ladder_build() and ticks snap to the nearest step, leaving only
+ * the commit itself to each tick.  A new target whose way lies within the
+ * steps already built keeps them, only a way beyond them builds anew.
+ */
+
+#ifndef __TRANSITION_H__
+#define __TRANSITION_H__
+
+/**\brief Step period in seconds until a commit has been timed */
+#define TRANSITION_STEP 0.1
+/**\brief Smallest noticeable step in mireds */
+#define TRANSITION_JND 2.0
+/**\brief Shortest step period in seconds */
+#define TRANSITION_STEP_MIN 0.02
+/**\brief Longest step period in seconds */
+#define TRANSITION_STEP_MAX 1.0
+
+/**\brief Clock driving transitions */
+typedef struct{
+	/**\brief Reads monotonic time in seconds */
+	int (*now)(/*@out@*/ double *now);
+	/**\brief Sleeps until an absolute time */
+	int (*sleep_until)(double deadline);
+} transition_clock_s;
+
+/**\brief Transition state */
+typedef struct{
+	/**\brief Temperature last committed */
+	int curr;
+	/**\brief Temperature at the start of the transition */
+	int from;
+	/**\brief Target temperature */
+	int target;
+	/**\brief Start time */
+	double start;
+	/**\brief Duration in seconds */
+	double duration;
+	/**\brief Speed in K/s */
+	int speed;
+	/**\brief Time of the next tick */
+	double deadline;
+	/**\brief Current step period */
+	double interval;
+	/**\brief Time of the last commit */
+	double committed;
+	/**\brief Number of prebuilt steps, 0 if ramps are built per step */
+	int rungs;
+	/**\brief Mireds of the first prebuilt step */
+	double rung0;
+	/**\brief Mireds between prebuilt steps */
+	double rung_step;
+	/**\brief Transition in progress? */
+	int active;
+	/**\brief Number of commits made by transitions */
+	unsigned long steps;
+	/**\brief Number of grid points dropped */
+	unsigned long dropped;
+	/**\brief Number of times the target changed in flight */
+	unsigned long retargets;
+	/**\brief Number of times steps were prebuilt */
+	unsigned long ladders;
+} transition_s;
+
+/**\brief Commit statistics of all transitions */
+typedef struct{
+	/**\brief Number of commits timed */
+	unsigned long commits;
+	/**\brief Number of grid points dropped */
+	unsigned long dropped;
+	/**\brief Smoothed commit latency in seconds */
+	double latency;
+	/**\brief Longest commit in seconds */
+	double latency_max;
+	/**\brief Total time spent committing in seconds */
+	double latency_total;
+} transition_stats_s;
+
+/**\brief Replaces the clock, NULL restores the system monotonic clock */
+void transition_set_clock(/*@null@*/ const transition_clock_s *clock);
+
+/**\brief Reads the transition clock */
+int transition_now(/*@out@*/ double *now);
+
+/**\brief Sleeps on the transition clock until deadline
+ * \return RET_FUN_FAILED if interrupted
+ */
+int transition_sleep_until(double deadline);
+
+/**\brief Initializes an idle transition
+ * \param trans transition
+ * \param curr temperature currently set
+ */
+void transition_init(/*@out@*/ transition_s *trans, int curr);
+
+/**\brief Starts a transition from the current temperature
+ * \details May be called at any time.  A transition in progress carries on
+ * from the temperature due at now, keeping its step period, so changing
+ * the target causes no extra commit or pause.  Setting the same target and
+ * speed again does nothing.
+ * \param trans transition
+ * \param target target temperature
+ * \param speed speed in K/s, 0 or less jumps to the target on the next tick
+ * \param now current clock time
+ */
+void transition_set_target(transition_s *trans, int target, int speed,
+		double now);
+
+/**\brief Commits the temperature due at now
+ * \details Does nothing if the transition is idle, the last tick commits
+ * the target and makes the transition idle.
+ * \return RET_FUN_FAILED if the commit failed
+ */
+int transition_tick(transition_s *trans, double now);
+
+/**\brief Retrieves the time of the next tick, negative if idle */
+double transition_next_deadline(const transition_s *trans);
+
+/**\brief Checks whether a transition is in progress */
+int transition_active(const transition_s *trans);
+
+/**\brief Retrieves commit statistics */
+void transition_get_stats(/*@out@*/ transition_stats_s *stats);
+
+#endif//__TRANSITION_H__
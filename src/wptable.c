@@ -0,0 +1,236 @@
+#include "common.h"
+#include "gamma.h"
+#include "wptable.h"
+#ifndef _WIN32
+# include <errno.h>
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+#endif
+
+/**\brief Mapped table state */
+typedef struct{
+	/**\brief Start of the mapping */
+	/*@null@*//*@owned@*/ void *base;
+	/**\brief Size of the mapping */
+	size_t size;
+	/**\brief Read into the heap instead of mapped? */
+	int copied;
+#ifdef _WIN32
+	/**\brief File mapping handle */
+	HANDLE mapping;
+#endif
+	/**\brief First record */
+	/*@null@*//*@dependent@*/ temp_gamma *table;
+	/**\brief Number of records */
+	int count;
+} wptable_s;
+
+static wptable_s Wptable;
+
+// Reads a small file into the heap
+static /*@null@*/ void *wptable_read(int fd, size_t size){
+	char *base = (char*)malloc(size);
+	size_t got = 0;
+	ssize_t n;
+
+	if( base==NULL )
+		return NULL;
+	while( got<size ){
+		n = read(fd,base+got,size-got);
+		if( (n<0) && (errno==EINTR) )
+			continue;
+		// Shrunk since fstat
+		if( n<=0 ){
+			free(base);
+			return NULL;
+		}
+		got += (size_t)n;
+	}
+	return base;
+}
+
+// Maps a whole file read only, small files are copied instead
+static /*@null@*/ void *wptable_map(const char *file, /*@out@*/ size_t *size,
+		/*@out@*/ wptable_s *state){
+#ifndef _WIN32
+	struct stat st;
+	void *base;
+	int fd = open(file,O_RDONLY);
+
+	(*size)=0;
+	state->copied=0;
+	if( fd<0 )
+		return NULL;
+	if( (fstat(fd,&st)!=0) || (st.st_size<=0) ){
+		(void)close(fd);
+		return NULL;
+	}
+	// A copy can not fault if the file is rewritten later
+	if( st.st_size<=WPTABLE_COPY_MAX ){
+		base = wptable_read(fd,(size_t)st.st_size);
+		(void)close(fd);
+		if( base==NULL )
+			return NULL;
+		state->copied=1;
+		(*size)=(size_t)st.st_size;
+		return base;
+	}
+	base = mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+	(void)close(fd);
+	if( base==MAP_FAILED )
+		return NULL;
+	(*size)=(size_t)st.st_size;
+	return base;
+#else
+	HANDLE fid;
+	DWORD size_hi;
+	DWORD size_lo;
+	void *base;
+
+	(*size)=0;
+	state->mapping=NULL;
+	fid = CreateFileA(file,GENERIC_READ,FILE_SHARE_READ,NULL,
+			OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+	if( fid==INVALID_HANDLE_VALUE )
+		return NULL;
+	size_lo = GetFileSize(fid,&size_hi);
+	if( (size_lo==INVALID_FILE_SIZE) || size_hi || !size_lo ){
+		(void)CloseHandle(fid);
+		return NULL;
+	}
+	state->mapping = CreateFileMappingA(fid,NULL,PAGE_READONLY,0,0,NULL);
+	(void)CloseHandle(fid);
+	if( state->mapping==NULL )
+		return NULL;
+	base = MapViewOfFile(state->mapping,FILE_MAP_READ,0,0,0);
+	if( base==NULL ){
+		(void)CloseHandle(state->mapping);
+		state->mapping=NULL;
+		return NULL;
+	}
+	(*size)=(size_t)size_lo;
+	return base;
+#endif
+}
+
+// Releases a mapping made by wptable_map
+static void wptable_unmap(wptable_s *state){
+	if( state->base==NULL )
+		return;
+#ifndef _WIN32
+	if( state->copied )
+		free(state->base);
+	else
+		(void)munmap(state->base,state->size);
+#else
+	(void)UnmapViewOfFile(state->base);
+	(void)CloseHandle(state->mapping);
+	state->mapping=NULL;
+#endif
+	state->base=NULL;
+	state->table=NULL;
+	state->size=0;
+	state->copied=0;
+	state->count=0;
+}
+
+// Checks header and records of a mapped table
+static int wptable_check(const char *file, const void *base, size_t size){
+	const wptable_header_s *hdr = (const wptable_header_s*)base;
+	const temp_gamma *table;
+	int step;
+	uint32_t i;
+
+	if( (size<sizeof(*hdr))
+			|| (memcmp(hdr->magic,WPTABLE_MAGIC,sizeof(hdr->magic))!=0) ){
+		LOG(LOGERR,_("%s is not a white point table"),file);
+		return RET_FUN_FAILED;
+	}
+	if( hdr->version!=WPTABLE_VERSION ){
+		LOG(LOGERR,_("%s: unsupported version or byte order (%u)"),
+				file,(unsigned)hdr->version);
+		return RET_FUN_FAILED;
+	}
+	if( hdr->record_size!=(uint32_t)sizeof(temp_gamma) ){
+		LOG(LOGERR,_("%s: record size %u, expected %u"),file,
+				(unsigned)hdr->record_size,(unsigned)sizeof(temp_gamma));
+		return RET_FUN_FAILED;
+	}
+	if( (hdr->count<2) || (hdr->count>(uint32_t)INT32_MAX)
+			|| ((size-sizeof(*hdr))/sizeof(temp_gamma)!=hdr->count)
+			|| ((size-sizeof(*hdr))%sizeof(temp_gamma)!=0) ){
+		LOG(LOGERR,_("%s: truncated or has %u records"),file,
+				(unsigned)hdr->count);
+		return RET_FUN_FAILED;
+	}
+	// Lookups assume an evenly spaced table of sane colors
+	table = (const temp_gamma*)(hdr+1);
+	step = table[1].temp-table[0].temp;
+	for( i=0; i<hdr->count; ++i ){
+		const gamma_s *c = &table[i].gamma;
+		if( (i>0) && (table[i].temp-table[i-1].temp!=step) ){
+			LOG(LOGERR,_("%s: temperatures must be evenly spaced"),file);
+			return RET_FUN_FAILED;
+		}
+		if( !(c->r>=0.0f && c->r<=1.0f) || !(c->g>=0.0f && c->g<=1.0f)
+				|| !(c->b>=0.0f && c->b<=1.0f) ){
+			LOG(LOGERR,_("%s: invalid color at %dK"),file,table[i].temp);
+			return RET_FUN_FAILED;
+		}
+	}
+	if( (step<=0) || (table[0].temp<=0) ){
+		LOG(LOGERR,_("%s: temperatures must be increasing"),file);
+		return RET_FUN_FAILED;
+	}
+	if( (table[0].temp>MIN_TEMP)
+			|| (table[hdr->count-1].temp<MAX_TEMP) ){
+		LOG(LOGERR,_("%s: table must cover %d-%dK"),file,MIN_TEMP,MAX_TEMP);
+		return RET_FUN_FAILED;
+	}
+	return RET_FUN_SUCCESS;
+}
+
+/* Maps a table file */
+int wptable_load(const char *file){
+	wptable_s state;
+	const wptable_header_s *hdr;
+
+	memset(&state,0,sizeof(state));
+	state.base = wptable_map(file,&state.size,&state);
+	if( state.base==NULL ){
+		LOG(LOGERR,_("Unable to map white point table %s"),file);
+		return RET_FUN_FAILED;
+	}
+	if( !wptable_check(file,state.base,state.size) ){
+		wptable_unmap(&state);
+		return RET_FUN_FAILED;
+	}
+	hdr = (const wptable_header_s*)state.base;
+	state.table = (temp_gamma*)(hdr+1);
+	state.count = (int)hdr->count;
+
+	wptable_unmap(&Wptable);
+	Wptable = state;
+	// Cached ramps and the index were built from the previous table
+	gamma_table_changed();
+	LOG(LOGINFO,_("Loaded white point table %s (%d entries, %d-%dK)"),
+			file,Wptable.count,Wptable.table[0].temp,
+			Wptable.table[Wptable.count-1].temp);
+	return RET_FUN_SUCCESS;
+}
+
+/* Retrieves the mapped table */
+temp_gamma *wptable_get(int *size){
+	(*size)=Wptable.count;
+	return Wptable.table;
+}
+
+/* Unmaps the table */
+void wptable_free(void){
+	if( Wptable.base==NULL )
+		return;
+	wptable_unmap(&Wptable);
+	// Back to the built-in table
+	gamma_table_changed();
+}
@@ -0,0 +1,53 @@
+/**\file		wptable.h
+ * \brief		Runtime loadable white point tables.
+ * \details
+ * A white point table file is a wptable_header_s followed by count
+ * temp_gamma records in native byte order, with evenly spaced and
+ * increasing temperatures.  Files up to WPTABLE_COPY_MAX bytes are read
+ * into memory, larger ones are mapped read only and the records are used
+ * in place, see opt_get_gammap().  Tables are written by
+ * genwhitepoint -f binary.
+ *
+ * A mapped table must not be rewritten while loaded, pages of a truncated
+ * file fault with SIGBUS.  Replace it by writing a new file and renaming
+ * it over the old one, then reload; the old file stays mapped until then.
+ */
+
+#ifndef __WPTABLE_H__
+#define __WPTABLE_H__
+
+/**\brief Magic bytes at the start of a table file */
+#define WPTABLE_MAGIC	"RSWP"
+/**\brief Current table file version */
+#define WPTABLE_VERSION	1
+/**\brief Largest table file read into memory instead of mapped */
+#define WPTABLE_COPY_MAX	(1024*1024)
+
+/**\brief Table file header */
+typedef struct{
+	/**\brief WPTABLE_MAGIC */
+	char magic[4];
+	/**\brief WPTABLE_VERSION, also detects byte order mismatches */
+	uint32_t version;
+	/**\brief Size of one record, must match sizeof(temp_gamma) */
+	uint32_t record_size;
+	/**\brief Number of records */
+	uint32_t count;
+} wptable_header_s;
+
+/**\brief Maps a table file, replacing any table mapped before
+ * \param file path of the table
+ * \return RET_FUN_FAILED if the file could not be mapped or is invalid
+ */
+int wptable_load(const char *file);
+
+/**\brief Retrieves the mapped table
+ * \param size set to the number of records
+ * \return NULL if no table is mapped
+ */
+/*@null@*//*@dependent@*/ temp_gamma *wptable_get(/*@out@*/ int *size);
+
+/**\brief Unmaps the table */
+void wptable_free(void);
+
+#endif//__WPTABLE_H__